@@ -3,17 +3,79 @@
 // Implements the Conditioning class
 #include "conditioning.h"
 
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <set>
+
+#include "sim_init.h"
+#include "sqlite_back.h"
+
 namespace conditioning {
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-Conditioning::Conditioning(cyclus::Context* ctx) 
+// state variables start at their defaults, as agents built without an input
+// file, such as those in the unit tests, never have them filled in
+Conditioning::Conditioning(cyclus::Context* ctx)
     : cyclus::Facility(ctx),
+      residence_time(0),
+      throughput(1e299),
+      max_inv_size(1e299),
+      fleet_size(1),
+      discrete_handling(false),
+      decay_on_release(false),
+      lookahead_requests(false),
+      request_quantum(0.0),
+      merge_materials(false),
+      lazy_split(false),
+      commodity_lanes(false),
+      package_strategy("none"),
+      package_fill_min(0.0),
+      package_fill_max(1e299),
+      discrete_selection("fifo"),
+      max_bypass(10),
+      head_bypass(0),
+      held_credit(0.0),
+      unreleased(0.0),
+      max_offers(0),
+      trace_level(0),
+      flow_report_period(0),
+      flow_start(0),
+      warm_start_time(-1),
+      warm_start_agent(-1),
+      warm_started(false),
+      warm_start_source(-1),
+      saved_version(0),
+      selection(SELECT_FIFO),
       latitude(0.0),
       longitude(0.0),
       coordinates(latitude, longitude) {
   cyclus::Warn<cyclus::EXPERIMENTAL_WARNING>(
       "The Conditioning Facility is experimental.");};
 
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+/// (warm_start_db, AgentId) of each facility whose state has been taken
+typedef std::set<std::pair<std::string, int> > WarmStartSources;
+
+/// the facilities each simulation has taken the state of, so that no two
+/// facilities take the same state
+static std::map<const cyclus::Context*, WarmStartSources>& WarmStartClaims() {
+  static std::map<const cyclus::Context*, WarmStartSources> claims;
+  return claims;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+Conditioning::~Conditioning() {
+  if (warm_start_source < 0) {
+    return;
+  }
+  WarmStartSources& claimed = WarmStartClaims()[context()];
+  claimed.erase(std::make_pair(warm_start_db, warm_start_source));
+  if (claimed.empty()) {
+    WarmStartClaims().erase(context());
+  }
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 // pragmas
 
@@ -21,36 +83,117 @@ Conditioning::Conditioning(cyclus::Context* ctx)
 
 #pragma cyclus def annotations conditioning::Conditioning
 
-#pragma cyclus def initinv conditioning::Conditioning
-
-#pragma cyclus def snapshotinv conditioning::Conditioning
-
 #pragma cyclus def infiletodb conditioning::Conditioning
 
-#pragma cyclus def snapshot conditioning::Conditioning
-
 #pragma cyclus def clone conditioning::Conditioning
 
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void Conditioning::InitFrom(Conditioning* m) {
 #pragma cyclus impl initfromcopy conditioning::Conditioning
   cyclus::toolkit::CommodityProducer::Copy(m);
+  LoadSchedule_();
 }
 
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void Conditioning::InitFrom(cyclus::QueryableBackend* b) {
 #pragma cyclus impl initfromdb conditioning::Conditioning
+  LoadSchedule_();
 
+  // with commodity_lanes, each lane ships one of out_commods; EnterNotify
+  // reports any that are left over
   using cyclus::toolkit::Commodity;
-  Commodity commod = Commodity(out_commods.front());
-  cyclus::toolkit::CommodityProducer::Add(commod);
-  cyclus::toolkit::CommodityProducer::SetCapacity(commod, throughput);
+  for (int i = 0; i < out_commods.size() && i < n_lanes(); ++i) {
+    Commodity commod = Commodity(out_commods[i]);
+    cyclus::toolkit::CommodityProducer::Add(commod);
+    cyclus::toolkit::CommodityProducer::SetCapacity(
+        commod, fleet_throughput() * (commodity_lanes ? shares[i] : 1));
+  }
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Conditioning::Snapshot(cyclus::DbInit di) {
+  SaveSchedule_();
+#pragma cyclus impl snapshot conditioning::Conditioning
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Conditioning::InitInv(cyclus::Inventories& inv) {
+  MakeLanes_();
+  for (int i = 0; i < n_lanes(); ++i) {
+    Lane l = lane(i);
+    std::string prefix = lane_prefix(i);
+    l.inventory.Push(inv[prefix + "inventory"]);
+    l.processing.Push(inv[prefix + "processing"]);
+    l.packaged.Push(inv[prefix + "packaged"]);
+    l.ready.Push(inv[prefix + "ready"]);
+    l.stocks.Push(inv[prefix + "stocks"]);
+  }
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+/// copies a buffer's contents into an inventory, leaving the buffer as it was
+template <class T>
+static void SnapshotBuf(cyclus::toolkit::ResBuf<T>& buf,
+                        std::vector<cyclus::Resource::Ptr>& inv) {
+  inv = buf.PopNRes(buf.count());
+  buf.Push(inv);
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+cyclus::Inventories Conditioning::SnapshotInv() {
+  // the first lane keeps the names a facility without lanes has always used
+  cyclus::Inventories invs;
+  for (int i = 0; i < n_lanes(); ++i) {
+    Lane l = lane(i);
+    std::string prefix = lane_prefix(i);
+    SnapshotBuf(l.inventory, invs[prefix + "inventory"]);
+    SnapshotBuf(l.processing, invs[prefix + "processing"]);
+    SnapshotBuf(l.packaged, invs[prefix + "packaged"]);
+    SnapshotBuf(l.ready, invs[prefix + "ready"]);
+    SnapshotBuf(l.stocks, invs[prefix + "stocks"]);
+  }
+  return invs;
 }
 
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void Conditioning::EnterNotify() {
   cyclus::Facility::EnterNotify();
-  buy_policy.Init(this, &inventory, std::string("inventory"));
+  trace.Init(trace_level, trace_file);
+  if (request_quantum < 0) {
+    std::stringstream ss;
+    ss << "request_quantum must not be negative, got " << request_quantum;
+    throw cyclus::ValueError(ss.str());
+  }
+
+  if (!commodity_lanes && out_commods.size() != 1) {
+    std::stringstream ss;
+    ss << "out_commods has " << out_commods.size() << " values, expected 1.";
+    throw cyclus::ValueError(ss.str());
+  } else if (commodity_lanes && out_commods.size() != in_commods.size()) {
+    std::stringstream ss;
+    ss << "out_commods has " << out_commods.size() << " values, expected "
+       << in_commods.size() << ", one for each of in_commods";
+    throw cyclus::ValueError(ss.str());
+  }
+  if (commodity_lanes && !lane_shares.empty()) {
+    if (lane_shares.size() != in_commods.size()) {
+      std::stringstream ss;
+      ss << "lane_shares has " << lane_shares.size() << " values, expected "
+         << in_commods.size();
+      throw cyclus::ValueError(ss.str());
+    }
+    double total = 0;
+    for (int i = 0; i < lane_shares.size(); ++i) {
+      if (lane_shares[i] < 0) {
+        throw cyclus::ValueError("lane_shares must not be negative");
+      }
+      total += lane_shares[i];
+    }
+    if (total <= 0) {
+      throw cyclus::ValueError("lane_shares must not all be zero");
+    }
+  }
+  MakeLanes_();
 
   // dummy comp, use in_recipe if provided
   cyclus::CompMap v;
@@ -70,20 +213,87 @@ void Conditioning::EnterNotify() {
     throw cyclus::ValueError(ss.str());
   }
 
-  for (int i = 0; i != in_commods.size(); ++i) {
-    buy_policy.Set(in_commods[i], comp, in_commod_prefs[i]);
+  // each lane requests its own commodity; without lanes the one lane
+  // requests them all
+  for (int i = 0; i < n_lanes(); ++i) {
+    cyclus::toolkit::MatlBuyPolicy& policy =
+        i == 0 ? buy_policy : lanes[i - 1].buy_policy;
+    Lane l = lane(i);
+    std::string name = lane_prefix(i) + "inventory";
+    if (request_quantum > 0) {
+      // inventory's capacity already limits what is requested each timestep
+      policy.Init(this, &l.inventory, name,
+                  std::numeric_limits<double>::max(), 1, 1, request_quantum);
+    } else {
+      policy.Init(this, &l.inventory, name);
+    }
+    for (int j = 0; j != in_commods.size(); ++j) {
+      if (!commodity_lanes || j == i) {
+        policy.Set(in_commods[j], comp, in_commod_prefs[j]);
+      }
+    }
+    policy.Start();
   }
-  buy_policy.Start();
 
-  if (out_commods.size() == 1) {
-    sell_policy.Init(this, &stocks, std::string("stocks"))
-        .Set(out_commods.front())
-        .Start();
-  } else {
+  if (package_strategy != "none" && package_strategy != "first" &&
+      package_strategy != "equal") {
+    throw cyclus::ValueError("package_strategy must be 'none', 'first' or "
+                             "'equal', not '" + package_strategy + "'");
+  }
+  if (discrete_handling && package_strategy != "none") {
+    throw cyclus::ValueError("package_strategy must be 'none' with "
+                             "discrete_handling, which never splits or "
+                             "combines batches");
+  }
+  if (package_fill_max <= 0 || package_fill_min > package_fill_max) {
     std::stringstream ss;
-    ss << "out_commods has " << out_commods.size() << " values, expected 1.";
+    ss << "package fill limits must satisfy 0 <= package_fill_min <= "
+       << "package_fill_max and package_fill_max > 0, got ["
+       << package_fill_min << ", " << package_fill_max << "]";
     throw cyclus::ValueError(ss.str());
   }
+
+  if (decay_on_release && context()->sim_info().decay == "lazy") {
+    throw cyclus::ValueError("decay_on_release cannot be used with the "
+                             "'lazy' simulation decay mode");
+  }
+
+  if (fleet_size < 1) {
+    std::stringstream ss;
+    ss << "fleet_size must be at least 1, got " << fleet_size;
+    throw cyclus::ValueError(ss.str());
+  }
+
+  if (max_offers < 0) {
+    std::stringstream ss;
+    ss << "max_offers must not be negative, got " << max_offers;
+    throw cyclus::ValueError(ss.str());
+  }
+
+  if (discrete_selection == "fifo") {
+    selection = SELECT_FIFO;
+  } else if (discrete_selection == "fill") {
+    selection = SELECT_FILL;
+  } else {
+    throw cyclus::ValueError("discrete_selection must be 'fifo' or 'fill', "
+                             "not '" + discrete_selection + "'");
+  }
+
+  for (int i = 0; i < n_lanes(); ++i) {
+    cyclus::toolkit::PackagedMatlSellPolicy& policy =
+        i == 0 ? sell_policy : lanes[i - 1].sell_policy;
+    Lane l = lane(i);
+    policy.Init(this, &l.stocks, lane_prefix(i) + "stocks")
+        .Set(out_commods[i])
+        .Start();
+    if (lazy_split) {
+      policy.set_throughput(l.offered());
+    }
+  }
+
+  if (!warm_start_db.empty() && !warm_started) {
+    WarmStart_();
+  }
   RecordPosition();
 }
 
@@ -91,13 +301,15 @@ void Conditioning::EnterNotify() {
 std::string Conditioning::str() {
   std::stringstream ss;
   std::string ans, out_str;
-  if (out_commods.size() == 1) {
+  if (!out_commods.empty()) {
     out_str = out_commods.front();
-  } else {
-    out_str = "";
   }
-  if (cyclus::toolkit::CommodityProducer::Produces(
-          cyclus::toolkit::Commodity(out_str))) {
+  for (int i = 1; i < out_commods.size(); ++i) {
+    out_str += ", " + out_commods[i];
+  }
+  if (!out_commods.empty() &&
+      cyclus::toolkit::CommodityProducer::Produces(
+          cyclus::toolkit::Commodity(out_commods.front()))) {
     ans = "yes";
   } else {
     ans = "no";
@@ -108,6 +320,7 @@ std::string Conditioning::str() {
      << "     Output Commodity = " << out_str << ",\n"
      << "     Residence Time = " << residence_time << ",\n"
      << "     Throughput = " << throughput << ",\n"
+     << "     Fleet Size = " << fleet_size << ",\n"
      << " commod producer members: "
      << " produces " << out_str << "?:" << ans << "'}";
   return ss.str();
@@ -115,132 +328,462 @@ std::string Conditioning::str() {
 
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void Conditioning::Tick() {
-  // Set available capacity for Buy Policy
-  inventory.capacity(current_capacity());
+  CYDER_PROFILE_PHASE(profile, PHASE_TICK);
+
+  // Set available capacity for each lane's Buy Policy
+  double cap = 0;
+  for (int i = 0; i < n_lanes(); ++i) {
+    Lane l = lane(i);
+    double lane_cap =
+        lookahead_requests ? forecast_capacity(l) : current_capacity(l);
+    if (request_quantum > 0) {
+      lane_cap = std::floor(lane_cap / request_quantum) * request_quantum;
+    }
+    l.inventory.capacity(lane_cap);
+    cap += lane_cap;
+  }
 
   LOG(cyclus::LEV_INFO3, "ComCnv") << prototype() << " is ticking {";
 
-  if (current_capacity() > cyclus::eps_rsrc()) {
+  if (cap > cyclus::eps_rsrc()) {
     LOG(cyclus::LEV_INFO4, "ComCnv")
-        << " has capacity for " << current_capacity() << " kg of material.";
+        << " has capacity for " << cap << " kg of material.";
   }
   LOG(cyclus::LEV_INFO3, "ComCnv") << "}";
 }
 
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+double Conditioning::forecast_capacity(const Lane& l) const {
+  double waiting = l.processing.quantity() + l.packaged.quantity() +
+                   l.ready.quantity() + l.unreleased;
+  double space = l.share * fleet_max_inv_size() - waiting - l.offered();
+
+  // everything waiting now is ready by the time new material is, less what
+  // throughput can release in the meantime
+  double throughput = l.share * fleet_throughput();
+  double backlog = std::max(0.0, waiting - throughput * residence_time);
+  double headroom = std::max(0.0, throughput - backlog);
+
+  return std::max(l.inventory.quantity(), std::min(space, headroom));
+}
+
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void Conditioning::Tock() {
   LOG(cyclus::LEV_INFO3, "ComCnv") << prototype() << " is tocking {";
 
-  BeginProcessing_();  // place unprocessed inventory into processing
-  PackageMatl_();
+  int time = context()->time();
+  Step_(time);
 
-  if (ready_time() >= 0 || residence_time == 0 && !inventory.empty()) {
-    ReadyMatl_(ready_time());  // place processing into ready
+  if (flow_report_period > 0 &&
+      ((time + 1) % flow_report_period == 0 || last_step())) {
+    RecordFlows_(time);
+  }
+  if (last_step()) {
+    trace.Flush(this);
+#ifdef CYDER_PROFILE
+    profile.Record(this);
+#endif
   }
-
-  ProcessMat_(throughput);  // place ready into stocks
 
   LOG(cyclus::LEV_INFO3, "ComCnv") << "}";
 }
 
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-void Conditioning::AddMat_(cyclus::Material::Ptr mat) {
-  LOG(cyclus::LEV_INFO5, "ComCnv") << prototype() << " is initially holding "
-                                   << inventory.quantity() << " total.";
+void Conditioning::Step_(int time) {
+  for (int i = 0; i < n_lanes(); ++i) {
+    Lane l = lane(i);
+    // inventory only holds what has been received since the last timestep
+    if (!l.inventory.empty()) {
+      CYDER_PROFILE_COUNT(profile, PHASE_RECEIVE, l.inventory.count());
+    }
+    if (NextEventTime_(l, time) == time) {
+      StepLane_(l, time);
+    }
+    // otherwise nothing arrived, nothing is due and nothing waits to leave
+  }
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Conditioning::StepLane_(Lane& l, int time) {
+  if (residence_time == 0 && package_strategy == "none" &&
+      l.processing.empty() && l.packaged.empty()) {
+    PassThrough_(l, time);  // nothing is held, place inventory into ready
+  } else {
+    BeginProcessing_(l, time);  // place unprocessed inventory into processing
+    PackageMatl_(l, time);
+
+    if (!l.schedule.empty()) {
+      ReadyMatl_(l, time);  // place packaged into ready
+    }
+  }
+
+  // place ready into stocks
+  ProcessMat_(l, l.share * fleet_throughput(), time);
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int Conditioning::NextEventTime_(int time) const {
+  int next = -1;
+  for (int i = 0; i < n_lanes(); ++i) {
+    int t = NextEventTime_(lane(i), time);
+    if (t >= 0 && (next < 0 || t < next)) {
+      next = t;
+    }
+  }
+  return next;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int Conditioning::NextEventTime_(const ConstLane& l, int time) const {
+  // new inventory has to be moved on and ready material waits on throughput
+  if (!l.inventory.empty() || !l.ready.empty() ||
+      l.unreleased > cyclus::eps_rsrc()) {
+    return time;
+  }
+  // material left in processing by repackaging only moves once more
+  // material arrives, otherwise processing is packaged straight away
+  if (!l.processing.empty() && package_strategy == "none") {
+    return time;
+  }
+  if (!l.schedule.empty()) {
+    return std::max(l.schedule.next_due(), time);
+  }
+  return -1;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Conditioning::Decommission() {
+  trace.Flush(this);
+#ifdef CYDER_PROFILE
+  profile.Record(this);
+#endif
+  cyclus::Facility::Decommission();
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Conditioning::AddMat_(cyclus::Material::Ptr mat, int i) {
+  try {
+    lane(i).inventory.Push(mat);
+  } catch (cyclus::Error& e) {
+    e.msg(Agent::InformErrorMsg(e.msg()));
+    throw e;
+  }
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Conditioning::BeginProcessing_(Lane& l, int time) {
+  if (l.inventory.empty()) {
+    return;
+  }
 
+  CYDER_PROFILE_PHASE(profile, PHASE_PROCESSING);
+  CYDER_PROFILE_ITEMS(l.inventory.count());
   try {
-    inventory.Push(mat);
+    CYDER_TRACE_EVENT(trace, TRACE_STAGE, this, time, "processing",
+                      l.inventory.count(), l.inventory.quantity());
+    flows.Add(FLOW_PROCESSING, l.inventory.count(), l.inventory.quantity());
+    l.processing.Push(TakeInventory_(l, time));
   } catch (cyclus::Error& e) {
     e.msg(Agent::InformErrorMsg(e.msg()));
     throw e;
   }
+}
 
-  LOG(cyclus::LEV_INFO5, "ComCnv")
-      << prototype() << " added " << mat->quantity()
-      << " of material to its inventory, which is holding "
-      << inventory.quantity() << " total.";
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+std::vector<cyclus::Material::Ptr> Conditioning::TakeInventory_(Lane& l,
+                                                                int time) {
+  using cyclus::Material;
+
+  std::vector<Material::Ptr> mats = l.inventory.PopN(l.inventory.count());
+  // the buy policy fills inventory behind the agent's back, so received
+  // batches are traced here, where the agent first sees them
+  if (trace.enabled(TRACE_BATCH)) {
+    for (int i = 0; i < mats.size(); ++i) {
+      CYDER_TRACE_EVENT(trace, TRACE_BATCH, this, time, "received", 1,
+                        mats[i]->quantity());
+    }
+  }
+  if (discrete_handling || !merge_materials || mats.size() < 2) {
+    return mats;
+  }
+
+  // composition id -> index of the merged batch
+  std::map<int, int> merged;
+  std::vector<Material::Ptr> out;
+  for (int i = 0; i < mats.size(); ++i) {
+    std::pair<std::map<int, int>::iterator, bool> it =
+        merged.insert(std::make_pair(mats[i]->comp()->id(), out.size()));
+    if (it.second) {
+      out.push_back(mats[i]);
+    } else {
+      out[it.first->second]->Absorb(mats[i]);
+    }
+  }
+  return out;
 }
 
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-void Conditioning::BeginProcessing_() {
-  while (inventory.count() > 0) {
-    try {
-      processing.Push(inventory.Pop());
-      entry_times.push_back(context()->time());
-      std::cout << "processed" << std::endl;
+void Conditioning::PackageMatl_(Lane& l, int time) {
+  if (l.processing.empty()) {
+    return;
+  }
 
-      LOG(cyclus::LEV_DEBUG2, "ComCnv")
-          << "Conditioning " << prototype()
-          << " added resources to processing at t= " << context()->time();
-    } catch (cyclus::Error& e) {
-      e.msg(Agent::InformErrorMsg(e.msg()));
-      throw e;
+  CYDER_PROFILE_PHASE(profile, PHASE_PACKAGING);
+  try {
+    if (package_strategy == "none") {
+      int n = l.processing.count();
+      CYDER_PROFILE_ITEMS(n);
+      CYDER_TRACE_EVENT(trace, TRACE_STAGE, this, time, "packaged",
+                        n, l.processing.quantity());
+      flows.Add(FLOW_PACKAGED, n, l.processing.quantity());
+      l.packaged.Push(l.processing.PopN(n));
+      l.schedule.Push(time + residence_time, n);
+    } else {
+      double processed = l.processing.quantity();
+      std::vector<cyclus::Material::Ptr> packages = Repackage_(l);
+      CYDER_PROFILE_ITEMS(packages.size());
+      CYDER_TRACE_EVENT(trace, TRACE_STAGE, this, time, "packaged",
+                        packages.size(), processed - l.processing.quantity());
+      flows.Add(FLOW_PACKAGED, packages.size(),
+                processed - l.processing.quantity());
+      l.packaged.Push(packages);
+      l.schedule.Push(time + residence_time, packages.size());
     }
+  } catch (cyclus::Error& e) {
+    e.msg(Agent::InformErrorMsg(e.msg()));
+    throw e;
   }
 }
 
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-void Conditioning::PackageMatl_() {
-   while (processing.count() > 0) {
-    try {
-      packaged.Push(processing.Pop());
-      std::cout << "packaged" << std::endl;
+std::vector<cyclus::Material::Ptr> Conditioning::Repackage_(Lane& l) {
+  using cyclus::Material;
 
-      LOG(cyclus::LEV_DEBUG2, "ComCnv")
-          << "Conditioning " << prototype()
-          << " added resources to packaged at t= " << context()->time();
-    } catch (cyclus::Error& e) {
-      e.msg(Agent::InformErrorMsg(e.msg()));
-      throw e;
+  std::vector<Material::Ptr> packages;
+  std::vector<Material::Ptr> mats = l.processing.PopN(l.processing.count());
+  Material::Ptr pool = mats.front();
+  for (int i = 1; i < mats.size(); ++i) {
+    pool->Absorb(mats[i]);
+  }
+
+  double fill = package_fill(pool->quantity());
+  while (pool->quantity() > cyclus::eps_rsrc() &&
+         pool->quantity() >= package_fill_min - cyclus::eps_rsrc()) {
+    if (pool->quantity() <= fill + cyclus::eps_rsrc()) {
+      packages.push_back(pool);
+      return packages;
     }
+    packages.push_back(pool->ExtractQty(fill));
+  }
+
+  // too little left for a package, wait for more material
+  if (pool->quantity() > cyclus::eps_rsrc()) {
+    l.processing.Push(pool);
   }
+  return packages;
 }
 
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-void Conditioning::ReadyMatl_(int time) {
+double Conditioning::package_fill(double qty) const {
+  if (package_strategy == "equal") {
+    // as few packages as the maximum fill allows, if they can all be filled
+    // to at least the minimum
+    double n_max_fill = std::ceil(qty / package_fill_max - cyclus::eps());
+    if (package_fill_min <= 0 ||
+        std::floor(qty / package_fill_min) >= n_max_fill) {
+      return qty / std::max(n_max_fill, 1.0);
+    }
+  }
+  return package_fill_max;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Conditioning::PassThrough_(Lane& l, int time) {
+  if (l.inventory.empty()) {
+    return;
+  }
+
+  CYDER_PROFILE_PHASE(profile, PHASE_READY);
+  CYDER_PROFILE_ITEMS(l.inventory.count());
+  try {
+    CYDER_TRACE_EVENT(trace, TRACE_STAGE, this, time, "passthrough",
+                      l.inventory.count(), l.inventory.quantity());
+    flows.Add(FLOW_READY, l.inventory.count(), l.inventory.quantity());
+    std::vector<cyclus::Material::Ptr> mats = TakeInventory_(l, time);
+    flows.Readied(l.index, time, mats.size());
+    l.ready.Push(mats);
+    if (discrete_handling && selection == SELECT_FILL) {
+      l.ready_index.Add(mats);
+    }
+  } catch (cyclus::Error& e) {
+    e.msg(Agent::InformErrorMsg(e.msg()));
+    throw e;
+  }
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Conditioning::ReadyMatl_(Lane& l, int time) {
   using cyclus::toolkit::ResBuf;
 
-  int to_ready = 0;
+  int to_ready = l.schedule.Release(time);
+  if (to_ready == 0) {
+    return;
+  }
+  CYDER_PROFILE_PHASE(profile, PHASE_READY);
+  CYDER_PROFILE_ITEMS(to_ready);
+
+  std::vector<cyclus::PackagedMaterial::Ptr> mats = l.packaged.PopN(to_ready);
+  double readied = l.ready.quantity();
+  l.ready.Push(mats);
+  if (discrete_handling && selection == SELECT_FILL) {
+    l.ready_index.Add(mats);
+  }
+  CYDER_TRACE_EVENT(trace, TRACE_STAGE, this, time, "ready", to_ready,
+                    l.ready.quantity() - readied);
+  flows.Add(FLOW_READY, to_ready, l.ready.quantity() - readied);
+  flows.Readied(l.index, time, to_ready);
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Conditioning::Decay_(
+    const std::vector<cyclus::PackagedMaterial::Ptr>& mats, int time) {
+  // batches are only ever decayed here, as they leave the facility, so the
+  // time since they were last decayed covers all the time they were held
+  for (int i = 0; i < mats.size(); ++i) {
+    int elapsed = time - mats[i]->prev_decay_time();
+    if (elapsed > 0) {
+      mats[i]->Transmute(DecayedComp_(mats[i]->comp(), elapsed));
+    }
+  }
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+cyclus::Composition::Ptr Conditioning::DecayedComp_(
+    cyclus::Composition::Ptr comp, int elapsed) {
+  using cyclus::Composition;
+
+  if (elapsed <= 0) {
+    return comp;
+  }
+
+  // repackaging makes a new composition for nearly every package, so the
+  // cache is emptied once it reaches the bound
+  static const int kMaxDecayCache = 1024;
+  if (decay_cache.size() > kMaxDecayCache) {
+    decay_cache.clear();
+  }
+
+  std::pair<int, int> key = std::make_pair(comp->id(), elapsed);
+  std::map<std::pair<int, int>, Composition::Ptr>::iterator it =
+      decay_cache.find(key);
+  if (it == decay_cache.end()) {
+    Composition::Ptr decayed = comp->Decay(elapsed, context()->dt());
+    it = decay_cache.insert(std::make_pair(key, decayed)).first;
+  }
+  return it->second;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Conditioning::Stock_(
+    Lane& l, const std::vector<cyclus::PackagedMaterial::Ptr>& mats,
+    int time) {
+  if (decay_on_release) {
+    Decay_(mats, time);
+  }
+
+  // discrete batches are only ever offered whole
+  if (max_offers <= 0 || discrete_handling) {
+    l.stocks.Push(mats);
+    return;
+  }
 
-  while (!entry_times.empty() && entry_times.front() <= time) {
-    entry_times.pop_front();
-    ++to_ready;
+  int i = 0;
+  for (; i < mats.size() && l.stocks.count() < max_offers; ++i) {
+    l.stocks.Push(mats[i]);
+  }
+  if (i == mats.size()) {
+    return;
   }
 
-  ready.Push(packaged.PopN(to_ready));
-  std::cout << "readyed" << std::endl;
+  // the newest item is the one most likely to still be offered next step,
+  // so it takes the rest and older offers are left as they are
+  cyclus::PackagedMaterial::Ptr open = l.stocks.PopBack();
+  for (; i < mats.size(); ++i) {
+    open->Absorb(mats[i]);
+  }
+  l.stocks.Push(open);
 }
 
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-void Conditioning::ProcessMat_(double cap) {
+void Conditioning::ProcessMat_(Lane& l, double cap, int time) {
   using cyclus::Material;
   using cyclus::ResCast;
   using cyclus::toolkit::ResBuf;
   using cyclus::toolkit::Manifest;
 
-  if (!ready.empty()) {
+  if (!l.ready.empty() || l.unreleased > cyclus::eps_rsrc()) {
+    CYDER_PROFILE_PHASE(profile, PHASE_STOCKS);
     try {
-      double max_pop = std::min(cap, ready.quantity());
+      double max_pop = std::min(cap, l.ready.quantity());
+      double stocked = l.offered();
+      int count = l.stocks.count();
+      int n_ready = l.ready.count();
+
+      // discrete batches are never combined, so with max_offers they only
+      // move while stocks has room for another offer
+      int slots = l.ready.count();
+      if (discrete_handling && max_offers > 0) {
+        slots = std::min(slots, std::max(0, max_offers - l.stocks.count()));
+      }
 
-      if (discrete_handling) {
-        if (max_pop == ready.quantity()) {
-          stocks.Push(ready.PopN(ready.count()));
+      if (discrete_handling && slots == 0) {
+        // the batches wait in ready until trades make room
+      } else if (discrete_handling) {
+        if (max_pop == l.ready.quantity() && slots == l.ready.count()) {
+          Stock_(l, l.ready.PopN(l.ready.count()), time);
+          l.ready_index.Clear();
+          l.head_bypass = 0;
+          l.held_credit = 0;
+        } else if (selection == SELECT_FILL) {
+          Stock_(l, FillBatches_(l, max_pop, slots), time);
         } else {
-          double cap_pop = ready.Peek()->quantity();
-          while (cap_pop <= max_pop && !ready.empty()) {
-            stocks.Push(ready.Pop());
-            cap_pop += ready.empty() ? 0 : ready.Peek()->quantity();
+          std::vector<cyclus::PackagedMaterial::Ptr> moved;
+          double cap_pop = l.ready.Peek()->quantity();
+          while (cap_pop <= max_pop && !l.ready.empty() &&
+                 moved.size() < slots) {
+            moved.push_back(l.ready.Pop());
+            cap_pop += l.ready.empty() ? 0 : l.ready.Peek()->quantity();
           }
+          Stock_(l, moved, time);
         }
+      } else if (lazy_split) {
+        ReleaseBatches_(l, cap, time);
       } else {
-        stocks.Push(ready.Pop(max_pop, cyclus::eps_rsrc()));
-        std::cout << "processedmat" << std::endl;
+        // batches that fit stay whole, so packages are not run together, and
+        // only the last one is split
+        std::vector<cyclus::PackagedMaterial::Ptr> moved;
+        double left = max_pop;
+        while (!l.ready.empty() &&
+               l.ready.Peek()->quantity() <= left + cyclus::eps_rsrc()) {
+          left -= l.ready.Peek()->quantity();
+          moved.push_back(l.ready.Pop());
+        }
+        if (left > cyclus::eps_rsrc() && !l.ready.empty()) {
+          moved.push_back(l.ready.Pop(left, cyclus::eps_rsrc()));
+        }
+        Stock_(l, moved, time);
       }
 
-      LOG(cyclus::LEV_INFO1, "ComCnv") << "Conditioning " << prototype()
-                                       << " moved resources"
-                                       << " from ready to stocks"
-                                       << " at t= " << context()->time();
+      CYDER_TRACE_EVENT(trace, TRACE_STAGE, this, time, "stocks",
+                        l.stocks.count() - count, l.offered() - stocked);
+      // batches are counted as they leave ready, so a split counts once the
+      // last of the batch has left, and with lazy_split a batch counts once
+      // its release starts
+      flows.Add(FLOW_STOCKS, n_ready - l.ready.count(),
+                l.offered() - stocked);
+      flows.Stocked(l.index, time, n_ready - l.ready.count(),
+                    residence_time);
+      CYDER_PROFILE_ITEMS(n_ready - l.ready.count());
     } catch (cyclus::Error& e) {
       e.msg(Agent::InformErrorMsg(e.msg()));
       throw e;
@@ -248,7 +791,365 @@ void Conditioning::ProcessMat_(double cap) {
   }
 }
 
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Conditioning::ReleaseBatches_(Lane& l, double cap, int time) {
+  // throughput releases what stocks still holds back before anything more
+  // moves in from ready
+  double release = std::min(cap, l.unreleased + l.ready.quantity());
+  double needed = release - l.unreleased;
+  l.unreleased = std::max(0.0, l.unreleased - release);
+
+  std::vector<cyclus::PackagedMaterial::Ptr> moved;
+  while (needed > cyclus::eps_rsrc() && !l.ready.empty()) {
+    moved.push_back(l.ready.Pop());
+    needed -= moved.back()->quantity();
+  }
+  if (needed < 0) {
+    l.unreleased = -needed;  // the part of the last batch not yet released
+  }
+  Stock_(l, moved, time);
+
+  // the policy splits a batch once part of it is traded
+  cyclus::toolkit::PackagedMatlSellPolicy& policy =
+      l.index == 0 ? sell_policy : lanes[l.index - 1].sell_policy;
+  policy.set_throughput(l.offered());
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+std::vector<cyclus::PackagedMaterial::Ptr> Conditioning::FillBatches_(
+    Lane& l, double cap, int max_n) {
+  using cyclus::PackagedMaterial;
+
+  ReadyIndex& index = l.ready_index;
+  if (index.size() != l.ready.count()) {
+    // ready was filled without the index, as from a snapshot
+    std::vector<PackagedMaterial::Ptr> batches = l.ready.PopN(l.ready.count());
+    index.Clear();
+    index.Add(batches);
+    l.ready.Push(batches);
+  }
+
+  // a head batch larger than the throughput can only leave if throughput is
+  // held back for it, which happens once it has been bypassed long enough
+  double head = index.oldest();
+  if (head > cap) {
+    ++l.head_bypass;
+  } else {
+    l.head_bypass = 0;
+    l.held_credit = 0;
+  }
+
+  int n_in_order = 0;
+  std::vector<ReadyIndex::Seq> later;
+  if (l.head_bypass > max_bypass) {
+    // the batch leaves whole once enough is held back, overshooting this
+    // timestep's throughput by what earlier timesteps held
+    l.held_credit += cap;
+    if (l.held_credit >= head) {
+      n_in_order = 1;
+      l.head_bypass = 0;
+      l.held_credit = 0;
+    }
+  } else {
+    // take batches in order while they fit, then fill what is left with the
+    // largest later batches that fit
+    double remaining = cap;
+    n_in_order = index.TakeInOrder(&remaining, max_n);
+    later = index.TakeLargest(&remaining, max_n - n_in_order);
+  }
+
+  std::vector<PackagedMaterial::Ptr> moved = l.ready.PopN(n_in_order);
+  index.PopOldest(n_in_order);
+  if (!later.empty()) {
+    // batches taken out of order have to be picked out of the rest
+    std::vector<bool> taken = index.Remove(later);
+    std::vector<PackagedMaterial::Ptr> batches = l.ready.PopN(l.ready.count());
+    std::vector<PackagedMaterial::Ptr> rest;
+    for (int i = 0; i < batches.size(); ++i) {
+      if (taken[i]) {
+        moved.push_back(batches[i]);
+      } else {
+        rest.push_back(batches[i]);
+      }
+    }
+    l.ready.Push(rest);
+  }
+  return moved;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Conditioning::RecordFlows_(int time) {
+  double occupancy[] = {0, 0, 0, 0, 0};
+  for (int i = 0; i < n_lanes(); ++i) {
+    Lane l = lane(i);
+    occupancy[0] += l.inventory.quantity();
+    occupancy[1] += l.processing.quantity();
+    occupancy[2] += l.packaged.quantity();
+    occupancy[3] += l.ready.quantity() + l.unreleased;
+    occupancy[4] += l.offered();
+  }
+  flows.Record(this, time, fleet_size, occupancy);
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Conditioning::LoadSchedule_() {
+  schedule.Clear();
+  std::map<int, int>::const_iterator it;
+  for (it = residence_schedule.begin(); it != residence_schedule.end(); ++it) {
+    schedule.Push(it->first, it->second);
+  }
+  saved_version = schedule.version();
+  LoadLanes_();
+  flows.Load(flow_start, flow_ready);
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Conditioning::LoadLanes_() {
+  MakeLanes_();
+  for (int i = 0; i < lanes.size(); ++i) {
+    lanes[i].schedule.Clear();
+    if (i < lane_held_credit.size()) {
+      lanes[i].held_credit = lane_held_credit[i];
+    }
+    if (i < lane_head_bypass.size()) {
+      lanes[i].head_bypass = lane_head_bypass[i];
+    }
+    if (i < lane_unreleased.size()) {
+      lanes[i].unreleased = lane_unreleased[i];
+    }
+  }
+  for (int i = 0; i + 2 < lane_schedule.size(); i += 3) {
+    if (lane_schedule[i] >= 1 && lane_schedule[i] < n_lanes()) {
+      lanes[lane_schedule[i] - 1].schedule.Push(lane_schedule[i + 1],
+                                                lane_schedule[i + 2]);
+    }
+  }
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Conditioning::SaveSchedule_() {
+  if (saved_version != schedule.version()) {
+    residence_schedule = schedule.Buckets();
+    saved_version = schedule.version();
+  }
+
+  // there are few lanes and snapshots are rare, so these are always encoded
+  lane_schedule.clear();
+  lane_held_credit.clear();
+  lane_head_bypass.clear();
+  lane_unreleased.clear();
+  for (int i = 0; i < lanes.size(); ++i) {
+    std::map<int, int> due = lanes[i].schedule.Buckets();
+    std::map<int, int>::const_iterator it;
+    for (it = due.begin(); it != due.end(); ++it) {
+      lane_schedule.push_back(i + 1);
+      lane_schedule.push_back(it->first);
+      lane_schedule.push_back(it->second);
+    }
+    lane_held_credit.push_back(lanes[i].held_credit);
+    lane_head_bypass.push_back(lanes[i].head_bypass);
+    lane_unreleased.push_back(lanes[i].unreleased);
+  }
+  flow_start = flows.start();
+  flow_ready = flows.ready();
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+Lane Conditioning::lane(int i) {
+  if (i == 0) {
+    return Lane(inventory, processing, packaged, ready, stocks, schedule,
+                ready_index, head_bypass, held_credit, unreleased, 0,
+                shares.front());
+  }
+  return Lane(lanes[i - 1], i, shares[i]);
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+ConstLane Conditioning::lane(int i) const {
+  if (i == 0) {
+    return ConstLane(inventory, processing, packaged, ready, stocks, schedule,
+                     unreleased, 0, shares.front());
+  }
+  return ConstLane(lanes[i - 1], i, shares[i]);
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+std::string Conditioning::lane_prefix(int i) {
+  if (i == 0) {
+    return "";
+  }
+  std::stringstream ss;
+  ss << "lane" << i << "_";
+  return ss.str();
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Conditioning::MakeLanes_() {
+  int n = commodity_lanes ? std::max<int>(1, in_commods.size()) : 1;
+  while (n_lanes() < n) {
+    lanes.emplace_back();
+  }
+
+  double total = 0;
+  for (int i = 0; i < lane_shares.size(); ++i) {
+    total += lane_shares[i];
+  }
+  shares.assign(n, 1.0 / n);
+  if (n > 1 && lane_shares.size() == n && total > 0) {
+    for (int i = 0; i < n; ++i) {
+      shares[i] = lane_shares[i] / total;
+    }
+  }
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Conditioning::WarmStart_() {
+  using cyclus::Cond;
+  using cyclus::Material;
+  using cyclus::QueryResult;
+
+  // sqlite would otherwise create an empty database and fail to find tables
+  if (!std::ifstream(warm_start_db.c_str()).good()) {
+    throw cyclus::ValueError("warm_start_db " + warm_start_db +
+                             " does not exist");
+  }
+  cyclus::SqliteBack b(warm_start_db);
+  std::vector<Cond> conds;
 
+  const WarmStartSources& claimed = WarmStartClaims()[context()];
+  int agent = warm_start_agent;
+  if (agent < 0) {
+    conds.push_back(Cond("Prototype", "==", prototype()));
+    QueryResult qr = b.Query("AgentEntry", &conds);
+    if (qr.rows.empty()) {
+      throw cyclus::ValueError("no facility with prototype " + prototype() +
+                               " in " + warm_start_db);
+    }
+    std::vector<int> ids;
+    for (int i = 0; i < qr.rows.size(); ++i) {
+      ids.push_back(qr.GetVal<int>("AgentId", i));
+    }
+    std::sort(ids.begin(), ids.end());
+    for (int i = 0; i < ids.size() && agent < 0; ++i) {
+      if (claimed.count(std::make_pair(warm_start_db, ids[i])) == 0) {
+        agent = ids[i];
+      }
+    }
+    if (agent < 0) {
+      std::stringstream ss;
+      ss << "the state of all " << ids.size() << " facilities with prototype "
+         << prototype() << " in " << warm_start_db << " has been taken";
+      throw cyclus::ValueError(ss.str());
+    }
+  } else if (claimed.count(std::make_pair(warm_start_db, agent)) > 0) {
+    std::stringstream ss;
+    ss << "the state of agent " << agent << " in " << warm_start_db
+       << " has already been taken by another facility";
+    throw cyclus::ValueError(ss.str());
+  }
+
+  // state is only recorded at snapshots; take the latest one in range
+  std::string spec = this->spec();
+  std::replace(spec.begin(), spec.end(), ':', '_');
+  conds.clear();
+  conds.push_back(Cond("AgentId", "==", agent));
+  if (warm_start_time >= 0) {
+    conds.push_back(Cond("SimTime", "<=", warm_start_time));
+  }
+  QueryResult state = b.Query("AgentState" + spec + "Info", &conds);
+  if (state.rows.empty()) {
+    std::stringstream ss;
+    ss << "no snapshot of agent " << agent << " in " << warm_start_db;
+    if (warm_start_time >= 0) {
+      ss << " at or before time " << warm_start_time;
+    }
+    throw cyclus::ValueError(ss.str());
+  }
+  int row = 0;
+  for (int i = 1; i < state.rows.size(); ++i) {
+    if (state.GetVal<int>("SimTime", i) > state.GetVal<int>("SimTime", row)) {
+      row = i;
+    }
+  }
+  int snapshot_time = state.GetVal<int>("SimTime", row);
+
+  // material becomes ready as long after now as it would have after the
+  // snapshot
+  int shift = context()->time() - snapshot_time;
+  std::map<int, int> due =
+      state.GetVal<std::map<int, int> >("residence_schedule", row);
+  schedule.Clear();
+  std::map<int, int>::const_iterator it;
+  for (it = due.begin(); it != due.end(); ++it) {
+    schedule.Push(it->first + shift, it->second);
+  }
+  head_bypass = state.GetVal<int>("head_bypass", row);
+  held_credit = state.GetVal<double>("held_credit", row);
+  unreleased = state.GetVal<double>("unreleased", row);
+  if (commodity_lanes) {
+    lane_schedule = state.GetVal<std::vector<int> >("lane_schedule", row);
+    for (int i = 1; i < lane_schedule.size(); i += 3) {
+      lane_schedule[i] += shift;
+    }
+    lane_held_credit =
+        state.GetVal<std::vector<double> >("lane_held_credit", row);
+    lane_head_bypass = state.GetVal<std::vector<int> >("lane_head_bypass",
+                                                       row);
+    lane_unreleased =
+        state.GetVal<std::vector<double> >("lane_unreleased", row);
+    LoadLanes_();
+  }
+  // ready batches keep their holdup so far; the reporting period starts now
+  flows.Load(context()->time(),
+             state.GetVal<std::vector<int> >("flow_ready", row), shift);
+
+  conds.clear();
+  conds.push_back(Cond("AgentId", "==", agent));
+  conds.push_back(Cond("SimTime", "==", snapshot_time));
+  QueryResult inv = b.Query("AgentStateInventories", &conds);
+  std::map<std::string, std::vector<Material::Ptr> > mats;
+  for (int i = 0; i < inv.rows.size(); ++i) {
+    Material::Ptr m = cyclus::SimInit::BuildMaterial(
+        &b, inv.GetVal<int>("ResourceId", i));
+    std::string name = inv.GetVal<std::string>("InventoryName", i);
+    cyclus::Composition::Ptr comp = m->comp();
+    // stocks were decayed as they were stocked; anything else is new to
+    // this simulation, so it is decayed now for the time it was held
+    // before the snapshot
+    bool stocked = name.size() >= 6 &&
+                   name.compare(name.size() - 6, 6, "stocks") == 0;
+    if (decay_on_release && !stocked) {
+      comp = DecayedComp_(comp, snapshot_time - m->prev_decay_time());
+    }
+    mats[name].push_back(Material::Create(this, m->quantity(), comp));
+  }
+  b.Close();
+
+  // bulk load each buffer, in the order it was held in
+  for (int i = 0; i < n_lanes(); ++i) {
+    Lane l = lane(i);
+    std::string prefix = lane_prefix(i);
+    l.inventory.Push(mats[prefix + "inventory"]);
+    l.processing.Push(mats[prefix + "processing"]);
+    l.packaged.Push(mats[prefix + "packaged"]);
+    l.ready.Push(mats[prefix + "ready"]);
+    l.stocks.Push(mats[prefix + "stocks"]);
+
+    if (l.schedule.count() != l.packaged.count()) {
+      std::stringstream ss;
+      ss << "snapshot of agent " << agent << " at time " << snapshot_time
+         << " schedules " << l.schedule.count() << " packaged batches in "
+         << "lane " << i << " but holds " << l.packaged.count();
+      throw cyclus::ValueError(ss.str());
+    }
+  }
+  saved_version = -1;  // residence_schedule is out of date
+  warm_started = true;
+  warm_start_source = agent;
+  WarmStartClaims()[context()].insert(std::make_pair(warm_start_db, agent));
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void Conditioning::RecordPosition() {
   std::string specification = this->spec();
   context()
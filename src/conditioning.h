@@ -3,12 +3,19 @@
 #ifndef CYCLUS_CONDITIONING_CONDITIONING_H_
 #define CYCLUS_CONDITIONING_CONDITIONING_H_
 
+#include <algorithm>
+#include <deque>
 #include <string>
-#include <list>
+#include <map>
 #include <vector>
 
 #include "cyclus.h"
+#include "conditioning_lane.h"
+#include "conditioning_profile.h"
+#include "conditioning_trace.h"
 #include "cyder_version.h"
+#include "flow_account.h"
+#include "residence_queue.h"
 
 // forward declaration
 namespace conditioning {
@@ -17,6 +24,12 @@ class Conditioning;
 
 
 namespace conditioning {
+/// How discrete batches are selected for release, see discrete_selection.
+enum BatchSelection {
+  SELECT_FIFO = 0,
+  SELECT_FILL
+};
+
 /// @class Conditioning
 ///
 /// This Facility is intended to hold materials for a user specified
@@ -34,13 +47,18 @@ namespace conditioning {
 ///
 /// @section agentparams Agent Parameters
 /// in_commods is a vector of strings naming the commodities that this facility receives
-/// out_commods is a string naming the commodity that in_commod is stocks into
+/// out_commods is a string naming the commodity that in_commod is stocks into,
+/// or with commodity_lanes one commodity per entry of in_commods
 /// residence_time is the minimum number of timesteps between receiving and offering
 /// in_recipe (optional) describes the incoming resource by recipe
 /// 
 /// @section optionalparams Optional Parameters
 /// max_inv_size is the maximum capacity of the inventory conditioning
 /// throughput is the maximum processing capacity per timestep
+/// fleet_size is the number of identical facilities the agent stands in for
+/// package_strategy, package_fill_min and package_fill_max describe how
+/// processed material is combined and split into standard packages
+/// commodity_lanes and lane_shares keep each input commodity apart
 ///
 /// @section detailed Detailed Behavior
 /// 
@@ -52,7 +70,9 @@ namespace conditioning {
 /// time) is placed in the stocks buffer.
 ///
 /// Any brand new inventory that was received in this timestep is placed into 
-/// the processing queue to begin waiting. 
+/// the processing queue to begin waiting. With a residence_time of zero and
+/// no repackaging, new inventory skips the intermediate buffers and goes
+/// straight to ready.
 /// 
 /// Making Requests:
 /// This facility requests all of the in_commod that it can.
@@ -66,6 +86,13 @@ namespace conditioning {
 ///
 /// Sending Resources:
 /// Matched resources are sent immediately.
+///
+/// @section lanes Commodity Lanes
+/// With commodity_lanes, each input commodity moves through a lane of its
+/// own: its own buffers, residence schedule, share of the throughput and
+/// max_inv_size, requests and offers. Lane i is offered as out_commods[i],
+/// so the exchange splits into one independent group of traders per lane.
+/// Each stage only works on the lanes that have something to do.
 class Conditioning 
   : public cyclus::Facility,
     public cyclus::toolkit::CommodityProducer,
@@ -73,6 +100,10 @@ class Conditioning
  public:  
   /// @param ctx the cyclus context for access to simulation-wide parameters
   Conditioning(cyclus::Context* ctx);
+
+  /// Lets another facility warm start from the one this one took its state
+  /// from.
+  virtual ~Conditioning();
   
   #pragma cyclus decl
 
@@ -81,7 +112,8 @@ class Conditioning
                               "are chosen based on the specified preferences list. Once the desired amount of material "\
                               "has entered the facility it is passed into a 'processing' buffer where it is held until "\
                               "the residence time has passed. The material is then passed into a 'ready' buffer where it is "\
-                              "queued for removal. Currently, all input commodities are lumped into a single output commodity. "\
+                              "queued for removal. By default, all input commodities are lumped into a single output commodity; "\
+                              "with commodity_lanes each input commodity is kept apart and offered as its own output commodity. "\
                               "Conditioning also has the functionality to handle materials in discrete or continuous batches. Discrete "\
                               "mode, which is the default, does not split or combine material batches. Continuous mode, however, "\
                               "divides material batches if necessary in order to push materials through the facility as quickly "\
@@ -102,35 +134,217 @@ class Conditioning
   /// The handleTick function specific to the Conditioning.
   virtual void Tock();
 
+  /// Writes out any buffered trace events and the phase profile before
+  /// leaving the simulation.
+  virtual void Decommission();
+
+  /// @brief the earliest timestep, no earlier than now, at which Tock has
+  /// anything to do given the material currently held. Material received
+  /// through the exchange also gives Tock work in the step it arrives.
+  /// @return the next event time, or -1 if nothing is pending
+  inline int NextEventTime() const {
+    return NextEventTime_(context()->time()); }
+
+#ifdef CYDER_PROFILE
+  /// @brief per-phase totals since they were last recorded
+  inline const Profile& phase_profile() const { return profile; }
+#endif
+
  protected:
   ///   @brief adds a material into the incoming commodity inventory
   ///   @param mat the material to add to the incoming inventory.
+  ///   @param i the lane whose inventory it goes into
   ///   @throws if there is trouble with pushing to the inventory buffer.
-  void AddMat_(cyclus::Material::Ptr mat);
+  void AddMat_(cyclus::Material::Ptr mat, int i = 0);
 
-  /// @brief Move all unprocessed inventory to processing
-  void BeginProcessing_();
+  /// @brief moves material through every stage for one timestep. This is
+  /// the body of Tock, taking the time explicitly so the pipeline can also be
+  /// stepped without a running Timer. Lanes with nothing to do at this time
+  /// are skipped.
+  /// @param time the current time
+  void Step_(int time);
+
+  /// @brief moves one lane's material through every stage for one timestep
+  /// @param l the lane
+  /// @param time the current time
+  void StepLane_(Lane& l, int time);
 
-/// @brief move ready resources from processing to packaged after repackaging
-  /// @param *** ADD HERE ***
-  void PackageMatl_();
+  /// @brief the next event time as seen from a given time, see NextEventTime
+  /// @param time the current time
+  int NextEventTime_(int time) const;
 
-  /// @brief move ready resources from packaged to ready at a certain time
-  /// @param time the time of interest
-  void ReadyMatl_(int time);
+  /// @brief the next event time of one lane, see NextEventTime
+  /// @param l the lane
+  /// @param time the current time
+  int NextEventTime_(const ConstLane& l, int time) const;
 
-  /// @brief Move as many ready resources as allowable into stocks
+  /// @brief Move all unprocessed inventory to processing
+  /// @param l the lane
+  /// @param time the current time
+  void BeginProcessing_(Lane& l, int time);
+
+  /// @brief empties inventory. With merge_materials in continuous mode,
+  /// batches that share a composition are absorbed into one. Each batch is
+  /// traced as received at trace level 2.
+  /// @param l the lane
+  /// @param time the current time
+  /// @return the batches, in the order their first member was received
+  std::vector<cyclus::Material::Ptr> TakeInventory_(Lane& l, int time);
+
+  /// @brief move ready resources from processing to packaged after repackaging
+  /// @param l the lane
+  /// @param time the current time, from which residence time is counted
+  void PackageMatl_(Lane& l, int time);
+
+  /// @brief combines everything in processing and splits it into packages
+  /// according to package_strategy. Material left over that is too small
+  /// for a package is returned to processing.
+  /// @param l the lane
+  /// @return the packages, each a separate material
+  std::vector<cyclus::Material::Ptr> Repackage_(Lane& l);
+
+  /// @brief the mass each package is filled to when repackaging
+  /// @param qty the total quantity being packaged
+  double package_fill(double qty) const;
+
+  /// @brief Move all unprocessed inventory straight to ready. Only valid
+  /// when nothing is held for residence time.
+  /// @param l the lane
+  /// @param time the current time
+  void PassThrough_(Lane& l, int time);
+
+  /// @brief move resources whose residence time has elapsed from packaged
+  /// to ready
+  /// @param l the lane
+  /// @param time the current time; batches due at or before it are released
+  void ReadyMatl_(Lane& l, int time);
+
+  /// @brief selects whole ready batches to fill the throughput as fully as
+  /// possible, using the lane's ReadyIndex. Ready is only rebuilt when
+  /// batches are selected out of order, keeping the rest in their original
+  /// order.
+  /// @param l the lane
+  /// @param cap current throughput capacity
+  /// @param max_n the most batches to select
+  /// @return the selected batches, oldest first
+  std::vector<cyclus::PackagedMaterial::Ptr> FillBatches_(Lane& l, double cap,
+                                                          int max_n);
+
+  /// @brief releases a lane's throughput with lazy_split. What stocks holds
+  /// back is released first, then whole ready batches move into stocks as
+  /// their release starts, and the sell policy is limited to what has been
+  /// released.
+  /// @param l the lane
+  /// @param cap current throughput capacity
+  /// @param time the current time
+  void ReleaseBatches_(Lane& l, double cap, int time);
+
+  /// @brief decays batches by the time since each was last decayed
+  /// @param mats the batches to decay
+  /// @param time the current time
+  void Decay_(const std::vector<cyclus::PackagedMaterial::Ptr>& mats,
+              int time);
+
+  /// @brief a composition decayed over a number of timesteps, reusing
+  /// decayed compositions from decay_cache where possible
+  /// @param comp the composition
+  /// @param elapsed the number of timesteps
+  cyclus::Composition::Ptr DecayedComp_(cyclus::Composition::Ptr comp,
+                                        int elapsed);
+
+  /// @brief pushes batches into stocks, decaying them first with
+  /// decay_on_release. With max_offers set and continuous handling, batches
+  /// that would take stocks past that many items are absorbed into its
+  /// newest item instead, so the sell policy has a bounded number of offers.
+  /// Discrete batches are never absorbed; ProcessMat_ only moves as many as
+  /// stocks has room for.
+  /// @param l the lane
+  /// @param mats the batches to stock
+  /// @param time the current time
+  void Stock_(Lane& l, const std::vector<cyclus::PackagedMaterial::Ptr>& mats,
+              int time);
+
+  /// @brief Move as many ready resources as allowable into stocks. With
+  /// lazy_split, batches move whole and the sell policy is limited to what
+  /// throughput has released.
+  /// @param l the lane
   /// @param cap current throughput capacity 
-  void ProcessMat_(double cap);
+  /// @param time the current time
+  void ProcessMat_(Lane& l, double cap, int time);
 
     /* --- Conditioning Members --- */
 
-  /// @brief current maximum amount that can be added to processing
-  inline double current_capacity() const { 
-    return (max_inv_size - processing.quantity() - stocks.quantity()); }
-
-  /// @brief returns the time key for ready materials
-  int ready_time(){ return context()->time() - residence_time; }
+  /// @brief current maximum amount that can be added to a lane's processing.
+  /// Stocks can outgrow max_inv_size, since packaged and ready material are
+  /// not counted, so this is never less than nothing.
+  /// @param l the lane
+  inline double current_capacity(const Lane& l) const { 
+    return std::max(0.0, l.share * fleet_max_inv_size() -
+                    l.processing.quantity() - l.offered()); }
+
+  /// @brief throughput of the whole fleet this agent models
+  inline double fleet_throughput() const { return throughput * fleet_size; }
+
+  /// @brief maximum inventory of the whole fleet this agent models
+  inline double fleet_max_inv_size() const {
+    return max_inv_size * fleet_size; }
+
+  /// @brief how much new material a lane can usefully absorb this
+  /// timestep. Counts every buffer against max_inv_size and projects the
+  /// ready backlog forward to when material received now finishes its
+  /// residence time. The projection assumes throughput is fully used every
+  /// step, so it never overstates the backlog. Only one timestep of
+  /// throughput is requested beyond that backlog.
+  /// @param l the lane
+  double forecast_capacity(const Lane& l) const;
+
+  /// @brief the number of lanes, 1 without commodity_lanes
+  inline int n_lanes() const { return 1 + lanes.size(); }
+
+  /// @brief a view of a lane's state
+  /// @param i the lane, in in_commods order
+  Lane lane(int i);
+
+  /// @brief a read-only view of a lane's state
+  /// @param i the lane, in in_commods order
+  ConstLane lane(int i) const;
+
+  /// @brief the prefix of a lane's buffer names in the inventory tables
+  /// @param i the lane
+  static std::string lane_prefix(int i);
+
+  /// @brief creates the state of every lane after the first, and works out
+  /// each lane's share, if that has not been done yet
+  void MakeLanes_();
+
+  /// @brief true on the last timestep of the simulation
+  inline bool last_step() const {
+    return context()->time() == context()->sim_info().duration - 1; }
+
+  /// @brief records the flow totals for the reporting period ending now
+  /// @param time the current time
+  void RecordFlows_(int time);
+
+  /// @brief rebuilds the residence schedule from residence_schedule, the
+  /// lanes after the first, see LoadLanes_, and the flow account's ready
+  /// batches from flow_start and flow_ready
+  void LoadSchedule_();
+
+  /// @brief rebuilds the residence schedule and release state of the lanes
+  /// after the first from lane_schedule, lane_held_credit, lane_head_bypass
+  /// and lane_unreleased
+  void LoadLanes_();
+
+  /// @brief encodes the residence schedule into residence_schedule, if it
+  /// has changed since it was last encoded, the state of lanes after the
+  /// first into lane_schedule, lane_held_credit, lane_head_bypass and
+  /// lane_unreleased, and the flow account's ready batches into flow_start
+  /// and flow_ready
+  void SaveSchedule_();
+
+  /// @brief fills the buffers and residence schedule from the snapshot of a
+  /// facility in warm_start_db
+  void WarmStart_();
 
   /* --- Module Members --- */
 
@@ -149,8 +363,9 @@ class Conditioning
   std::vector<double> in_commod_prefs;
 
   #pragma cyclus var {"tooltip":"output commodity",\
-                      "doc":"commodity produced by this facility. Multiple commodity tracking is"\
-                      " currently not supported, one output commodity catches all input commodities.",\
+                      "doc":"commodity produced by this facility. Without commodity_lanes, one output "\
+                      "commodity catches all input commodities. With commodity_lanes, there is one "\
+                      "output commodity for each input commodity, in the same order.",\
                       "uilabel":"Output Commodities",\
                       "uitype":["oneormore","outcommodity"]}
   std::vector<std::string> out_commods;
@@ -189,6 +404,18 @@ class Conditioning
                       "units":"kg"}
   double max_inv_size; 
 
+  #pragma cyclus var {"default": 1,\
+                      "tooltip":"number of identical facilities modelled",\
+                      "doc":"Number of identical conditioning facilities this agent stands in for. "\
+                            "throughput and max_inv_size are per facility and are scaled by this "\
+                            "number; the fleet shares one set of buffers, requests and offers. "\
+                            "ConditioningFlows records the fleet size so totals can be divided "\
+                            "back into per facility figures.",\
+                      "uilabel":"Fleet Size",\
+                      "uitype": "range", \
+                      "range": [1, 100000]}
+  int fleet_size;
+
   #pragma cyclus var {"default": False,\
                       "tooltip":"Bool to determine how Conditioning handles batches",\
                       "doc":"Determines if Conditioning will divide resource objects. Only controls material "\
@@ -196,7 +423,280 @@ class Conditioning
                             "If true, batches are handled as discrete quanta, neither split nor combined. "\
                             "Otherwise, batches may be divided during processing. Default to false (continuous))",\
                       "uilabel":"Batch Handling"}
-  bool discrete_handling;                    
+  bool discrete_handling;
+
+  #pragma cyclus var {"default": False,\
+                      "tooltip":"decay material over the time it is held",\
+                      "doc":"If true, each batch is decayed as it is released to stocks, by the time "\
+                            "since it was last decayed, which for material not decayed upstream is "\
+                            "since it was created. Material held past its residence time, such as "\
+                            "material waiting in processing for a package or batches bypassed by "\
+                            "'fill' selection, is decayed for all of it. "\
+                            "Decayed compositions are cached by source composition and elapsed time, "\
+                            "so batches sharing a recipe are decayed once. Cannot be combined with "\
+                            "the 'lazy' simulation decay mode, which would decay batches again.",\
+                      "uilabel":"Decay on Release"}
+  bool decay_on_release;
+
+  #pragma cyclus var {"default": False,\
+                      "tooltip":"size requests to what can be processed",\
+                      "doc":"If true, requests are limited to what the facility can absorb: every "\
+                            "buffer counts against max_inv_size, and no more than one timestep of "\
+                            "throughput is requested beyond the backlog projected for when new "\
+                            "material finishes its residence time. Otherwise the facility requests "\
+                            "max_inv_size less what is held in processing and stocks.",\
+                      "uilabel":"Look-ahead Requests"}
+  bool lookahead_requests;
+
+  #pragma cyclus var {"default": 0.0,\
+                      "tooltip":"size of each requested lot (kg)",\
+                      "doc":"If positive, material is requested in lots of this size, such as one "\
+                            "package, and requested capacity is rounded down to a whole number of "\
+                            "lots. Requests then stay the same from one timestep to the next "\
+                            "until capacity changes by a whole lot. Requests for all in_commods "\
+                            "share one portfolio either way. 0 requests all available capacity "\
+                            "in a single request per commodity.",\
+                      "uilabel":"Request Lot Size",\
+                      "uitype": "range", \
+                      "range": [0.0, 1e299], \
+                      "units":"kg"}
+  double request_quantum;
+
+  #pragma cyclus var {"default": False,\
+                      "tooltip":"merge batches that share a composition",\
+                      "doc":"Only used with continuous batch handling. If true, batches received in "\
+                            "the same timestep that share a composition are absorbed into a single "\
+                            "batch as they enter processing. They would become ready together in "\
+                            "any case, so only the number of resource objects held changes.",\
+                      "uilabel":"Merge Materials"}
+  bool merge_materials;
+
+  #pragma cyclus var {"default": False,\
+                      "tooltip":"split batches only when they are traded",\
+                      "doc":"Only used with continuous batch handling. If true, ready batches move "\
+                            "to stocks whole as soon as throughput starts releasing them, and the "\
+                            "sell policy offers no more than throughput has released so far. A batch "\
+                            "is then only split when part of it is traded, rather than every "\
+                            "timestep throughput is below what is ready, so far fewer resource "\
+                            "objects are created when throughput is the bottleneck. What is offered "\
+                            "each timestep is the same either way.",\
+                      "uilabel":"Lazy Splitting"}
+  bool lazy_split;
+
+  #pragma cyclus var {"default": False,\
+                      "tooltip":"keep input commodities apart",\
+                      "doc":"If true, each input commodity moves through a lane of its own, with its "\
+                            "own buffers, residence schedule, requests and offers, and is offered as "\
+                            "the output commodity at the same position in out_commods. Each lane has "\
+                            "its share of throughput and max_inv_size, given by lane_shares. Sinks "\
+                            "then only trade with the lanes whose commodities they request, which "\
+                            "splits the exchange into smaller independent groups. The flow totals and "\
+                            "trace cover all lanes together.",\
+                      "uilabel":"Commodity Lanes"}
+  bool commodity_lanes;
+
+  #pragma cyclus var {"default": [],\
+                      "tooltip":"share of throughput for each lane",\
+                      "doc":"Only used with commodity_lanes. Relative share of throughput and "\
+                            "max_inv_size given to each input commodity's lane, in the same order as "\
+                            "in_commods. Shares are divided by their sum. Defaults to equal shares.",\
+                      "uilabel":"Lane Shares",\
+                      "range": [None, [0.0, 1e299]], \
+                      "uitype":["oneormore", "range"]}
+  std::vector<double> lane_shares;
+
+  //// residence schedule of each lane after the first, as (lane, due time,
+  //// number of batches) triples. Brought up to date by Snapshot, like
+  //// residence_schedule.
+  #pragma cyclus var {"default": [],\
+                      "internal": True}
+  std::vector<int> lane_schedule;
+
+  //// held_credit of each lane after the first
+  #pragma cyclus var {"default": [],\
+                      "internal": True}
+  std::vector<double> lane_held_credit;
+
+  //// head_bypass of each lane after the first
+  #pragma cyclus var {"default": [],\
+                      "internal": True}
+  std::vector<int> lane_head_bypass;
+
+  //// unreleased of each lane after the first
+  #pragma cyclus var {"default": [],\
+                      "internal": True}
+  std::vector<double> lane_unreleased;
+
+  #pragma cyclus var {"default": "none",\
+                      "tooltip":"how processed material is repackaged",\
+                      "doc":"'none' packages every received batch on its own. 'first' combines "\
+                            "processed material and fills packages to package_fill_max, the last "\
+                            "one with whatever remains. 'equal' combines processed material and "\
+                            "divides it evenly into as few packages as package_fill_max allows. "\
+                            "With either strategy, material that would make a package lighter than "\
+                            "package_fill_min waits in processing for more material. Repackaging "\
+                            "splits and combines batches, so it must be 'none' with "\
+                            "discrete_handling.",\
+                      "uilabel":"Packaging Strategy",\
+                      "categorical": ["none", "first", "equal"]}
+  std::string package_strategy;
+
+  #pragma cyclus var {"default": 0.0,\
+                      "tooltip":"minimum package fill (kg)",\
+                      "doc":"the least material a package may hold when repackaging (kg)",\
+                      "uilabel":"Minimum Package Fill",\
+                      "uitype": "range", \
+                      "range": [0.0, 1e299], \
+                      "units":"kg"}
+  double package_fill_min;
+
+  #pragma cyclus var {"default": 1e299,\
+                      "tooltip":"maximum package fill (kg)",\
+                      "doc":"the most material a package may hold when repackaging (kg)",\
+                      "uilabel":"Maximum Package Fill",\
+                      "uitype": "range", \
+                      "range": [0.0, 1e299], \
+                      "units":"kg"}
+  double package_fill_max;
+
+  #pragma cyclus var {"default": "fifo",\
+                      "tooltip":"how discrete batches are selected for release",\
+                      "doc":"Only used with discrete batch handling. 'fifo' releases ready batches "\
+                            "in order and stops at the first one that exceeds the remaining "\
+                            "throughput. 'fill' releases the in-order batches that fit and then fills "\
+                            "the remaining throughput with the largest later batches that fit.",\
+                      "uilabel":"Discrete Batch Selection",\
+                      "categorical": ["fifo", "fill"]}
+  std::string discrete_selection;
+
+  #pragma cyclus var {"default": 10,\
+                      "tooltip":"maximum timesteps a batch may be bypassed",\
+                      "doc":"Only used with 'fill' batch selection. If the oldest ready batch is "\
+                            "larger than the throughput it is bypassed by smaller batches for at most "\
+                            "this many timesteps. After that, throughput is held back until the batch "\
+                            "can be released on its own. Being whole, it then leaves in a single "\
+                            "timestep, so that timestep releases more than the throughput, while the "\
+                            "average over the timesteps it was held for stays within it.",\
+                      "uilabel":"Maximum Bypass Time",\
+                      "units":"time steps",\
+                      "uitype": "range", \
+                      "range": [0, 12000]}
+  int max_bypass;
+
+  //// number of consecutive timesteps the oldest ready batch has been bypassed
+  #pragma cyclus var {"default": 0,\
+                      "internal": True}
+  int head_bypass;
+
+  //// throughput held back for a bypassed batch that exceeds the throughput
+  #pragma cyclus var {"default": 0.0,\
+                      "internal": True}
+  double held_credit;                    
+
+  //// quantity in stocks that throughput has not released yet, with
+  //// lazy_split. The sell policy offers only the rest.
+  #pragma cyclus var {"default": 0.0,\
+                      "internal": True}
+  double unreleased;
+
+  #pragma cyclus var {"default": 0,\
+                      "tooltip":"maximum number of items offered from stocks",\
+                      "doc":"If positive, stocks holds at most this many items, so the number of "\
+                            "bids offered each timestep stays bounded however much is stocked. "\
+                            "With continuous handling, material moved in beyond that is combined "\
+                            "into the newest item; items that are not added to keep their identity "\
+                            "from one timestep to the next. Discrete batches are never combined, "\
+                            "so with discrete_handling batches past the limit wait in ready, "\
+                            "without using throughput, until trades make room in stocks. 0 offers "\
+                            "every stocked batch on its own.",\
+                      "uilabel":"Maximum Offers",\
+                      "uitype": "range", \
+                      "range": [0, 100000]}
+  int max_offers;
+
+  #pragma cyclus var {"default": 0,\
+                      "tooltip":"trace verbosity",\
+                      "doc":"Verbosity of the per-agent event trace: 0 records nothing, 1 records "\
+                            "each stage move, 2 also records every received batch. Only has an "\
+                            "effect if cyder was built with CYDER_TRACE.",\
+                      "uilabel":"Trace Level",\
+                      "uitype": "range", \
+                      "range": [0, 2]}
+  int trace_level;
+
+  #pragma cyclus var {"default": "",\
+                      "tooltip":"trace output file",\
+                      "doc":"CSV file that trace events are appended to. If unspecified, events are "\
+                            "recorded in the ConditioningTrace table.",\
+                      "uilabel":"Trace File"}
+  std::string trace_file;
+
+  #pragma cyclus var {"default": 0,\
+                      "tooltip":"flow reporting period (timesteps)",\
+                      "doc":"Number of timesteps covered by each row of the ConditioningFlows table, "\
+                            "which holds the material and batches moved into each stage, the "\
+                            "material held in each buffer and a histogram of holdup times. "\
+                            "Batches are not told apart in ready, so with 'fill' selection "\
+                            "batches that leave out of order are counted as the oldest ones and "\
+                            "the histogram is approximate. 0 disables the table.",\
+                      "units":"time steps",\
+                      "uilabel":"Flow Reporting Period",\
+                      "uitype": "range", \
+                      "range": [0, 12000]}
+  int flow_report_period;
+
+  //// first timestep of the current flow reporting period. Brought up to
+  //// date by Snapshot.
+  #pragma cyclus var {"default": 0,\
+                      "internal": True}
+  int flow_start;
+
+  //// batches in each lane's ready buffer, as (lane, time readied, number of
+  //// batches) triples, from which flows works out holdup times. Brought up
+  //// to date by Snapshot.
+  #pragma cyclus var {"default": [],\
+                      "internal": True}
+  std::vector<int> flow_ready;
+
+  #pragma cyclus var {"default": "",\
+                      "tooltip":"output database to warm start from",\
+                      "doc":"Path to the SQLite output database of an earlier run. If given, the "\
+                            "facility starts with the buffers, residence schedule and throughput "\
+                            "credit that a Conditioning facility held in that run, as of its "\
+                            "latest snapshot at or before warm_start_time. Times material is due "\
+                            "to become ready are shifted so that it has as long left to wait as "\
+                            "it did then. Material is recreated rather than traded, so its "\
+                            "history starts in this run. The database must exist.",\
+                      "uilabel":"Warm Start Database"}
+  std::string warm_start_db;
+
+  #pragma cyclus var {"default": -1,\
+                      "tooltip":"timestep to warm start from",\
+                      "doc":"Timestep of warm_start_db to take the facility's state from. The "\
+                            "latest snapshot at or before it is used; -1 uses the last one.",\
+                      "uilabel":"Warm Start Time",\
+                      "units":"time steps"}
+  int warm_start_time;
+
+  #pragma cyclus var {"default": -1,\
+                      "tooltip":"agent to warm start from",\
+                      "doc":"AgentId in warm_start_db of the facility to take the state from. "\
+                            "-1 uses the first facility built from a prototype of the same name "\
+                            "as this one that no facility in this simulation has taken the state "\
+                            "of yet, so a fleet built from one prototype takes over an earlier "\
+                            "fleet's state one facility each rather than copying it. No two "\
+                            "facilities may take the state of the same one.",\
+                      "uilabel":"Warm Start Agent"}
+  int warm_start_agent;
+
+  //// whether the buffers have been filled from warm_start_db, so a restart
+  //// does not fill them again
+  #pragma cyclus var {"default": False,\
+                      "internal": True}
+  bool warm_started;
+
+  //// AgentId in warm_start_db this facility took its state from, -1 if none
+  int warm_start_source;
 
   #pragma cyclus var {"tooltip":"Incoming material buffer"}
   cyclus::toolkit::ResBuf<cyclus::Material> inventory;
@@ -207,10 +707,21 @@ class Conditioning
   #pragma cyclus var {"tooltip":"Buffer for material held for required residence_time"}
   cyclus::toolkit::ResBuf<cyclus::PackagedMaterial> ready;
 
-  //// list of input times for materials entering the processing buffer
-  #pragma cyclus var{"default": [],\
+  //// number of batches in the packaged buffer for each time they become
+  //// ready. This is only the persisted, run-length encoded form of schedule
+  //// and is brought up to date by Snapshot; use schedule at runtime.
+  #pragma cyclus var{"default": {},\
                       "internal": True}
-  std::list<int> entry_times;
+  std::map<int, int> residence_schedule;
+
+  //// batches in the packaged buffer, bucketed by the time they become ready
+  ResidenceQueue schedule;
+
+  //// batches in the ready buffer, only kept with 'fill' selection
+  ReadyIndex ready_index;
+
+  //// schedule version last encoded into residence_schedule
+  int saved_version;
 
   #pragma cyclus var {"tooltip":"Buffer for material still waiting for required residence_time"}
   cyclus::toolkit::ResBuf<cyclus::Material> processing;
@@ -218,6 +729,30 @@ class Conditioning
     #pragma cyclus var {"tooltip":"Buffer for material that just got packaged and are still waiting for required residence time "}
   cyclus::toolkit::ResBuf<cyclus::PackagedMaterial> packaged;
 
+  //// state of each lane after the first with commodity_lanes. A deque, so
+  //// the buffers the policies hold on to never move.
+  std::deque<LaneState> lanes;
+
+  //// share of throughput and max_inv_size of each lane
+  std::vector<double> shares;
+
+  //// discrete_selection, resolved by EnterNotify
+  BatchSelection selection;
+
+  //// buffered event trace, see CYDER_TRACE_EVENT
+  Trace trace;
+
+  //// per-stage totals for the current flow reporting period
+  FlowAccount flows;
+
+#ifdef CYDER_PROFILE
+  //// per-phase timing, see CYDER_PROFILE_PHASE
+  Profile profile;
+#endif
+
+  //// decayed compositions, keyed by (source composition id, elapsed steps)
+  std::map<std::pair<int, int>, cyclus::Composition::Ptr> decay_cache;
+
   //// A policy for requesting material
   cyclus::toolkit::MatlBuyPolicy buy_policy;
 
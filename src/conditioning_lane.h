@@ -0,0 +1,279 @@
+#ifndef CYDER_SRC_CONDITIONING_LANE_H_
+#define CYDER_SRC_CONDITIONING_LANE_H_
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cyclus.h"
+#include "residence_queue.h"
+
+namespace conditioning {
+
+/// @class ReadyIndex
+///
+/// The batches in a lane's ready buffer, oldest first and by quantity, kept
+/// up to date as batches become ready and leave so that 'fill' selection
+/// does not have to sort the whole buffer every timestep. Batches are added
+/// in the order they are pushed into ready, so the oldest batches in the
+/// index are the first ones in the buffer.
+class ReadyIndex {
+ public:
+  /// the order a batch was added in
+  typedef long Seq;
+
+  ReadyIndex() : next_(0) {}
+
+  /// @brief the number of batches indexed
+  inline int size() const { return by_age_.size(); }
+
+  /// @brief the quantity of the oldest batch (kg)
+  inline double oldest() const { return by_age_.begin()->second; }
+
+  /// @brief indexes batches as they are pushed into ready
+  template <class T>
+  void Add(const std::vector<T>& mats) {
+    for (int i = 0; i < mats.size(); ++i) {
+      by_age_.insert(by_age_.end(), std::make_pair(next_, mats[i]->quantity()));
+      by_qty_.insert(std::make_pair(mats[i]->quantity(), next_));
+      ++next_;
+    }
+  }
+
+  /// @brief forgets every batch
+  void Clear() {
+    by_age_.clear();
+    by_qty_.clear();
+  }
+
+  /// @brief selects the oldest batches while they fit. They stay indexed
+  /// until PopOldest.
+  /// @param remaining the quantity left to fill, less what is selected (kg)
+  /// @param max_n the most batches to select
+  /// @return the number of batches selected
+  int TakeInOrder(double* remaining, int max_n) {
+    int n = 0;
+    std::map<Seq, double>::const_iterator it = by_age_.begin();
+    for (; it != by_age_.end() && it->second <= *remaining && n < max_n;
+         ++it, ++n) {
+      *remaining -= it->second;
+      by_qty_.erase(std::make_pair(it->second, it->first));
+    }
+    return n;
+  }
+
+  /// @brief selects the largest batches that fit, the oldest of equal ones
+  /// first, among those not selected yet
+  /// @param remaining the quantity left to fill, less what is selected (kg)
+  /// @param max_n the most batches to select
+  /// @return the batches selected, oldest first
+  std::vector<Seq> TakeLargest(double* remaining, int max_n) {
+    std::vector<Seq> taken;
+    while (!by_qty_.empty() && taken.size() < max_n) {
+      std::set<std::pair<double, Seq> >::iterator it = by_qty_.upper_bound(
+          std::make_pair(*remaining, std::numeric_limits<Seq>::max()));
+      if (it == by_qty_.begin()) {
+        break;
+      }
+      it = by_qty_.lower_bound(std::make_pair((--it)->first, Seq(-1)));
+      *remaining -= it->first;
+      taken.push_back(it->second);
+      by_qty_.erase(it);
+    }
+    std::sort(taken.begin(), taken.end());
+    return taken;
+  }
+
+  /// @brief forgets the oldest batches, once they have left ready
+  void PopOldest(int n) {
+    for (; n > 0; --n) {
+      by_qty_.erase(std::make_pair(by_age_.begin()->second,
+                                   by_age_.begin()->first));
+      by_age_.erase(by_age_.begin());
+    }
+  }
+
+  /// @brief forgets batches selected out of order
+  /// @param seqs the batches, oldest first
+  /// @return for each batch still indexed, oldest first, whether it was
+  /// one of them
+  std::vector<bool> Remove(const std::vector<Seq>& seqs) {
+    std::vector<bool> removed;
+    removed.reserve(by_age_.size());
+    std::vector<Seq>::const_iterator s = seqs.begin();
+    std::map<Seq, double>::iterator it = by_age_.begin();
+    while (it != by_age_.end()) {
+      bool match = s != seqs.end() && *s == it->first;
+      removed.push_back(match);
+      if (match) {
+        by_qty_.erase(std::make_pair(it->second, it->first));
+        by_age_.erase(it++);
+        ++s;
+      } else {
+        ++it;
+      }
+    }
+    return removed;
+  }
+
+ private:
+  Seq next_;
+  std::map<Seq, double> by_age_;
+  std::set<std::pair<double, Seq> > by_qty_;
+};
+
+/// @class LaneState
+///
+/// The buffers, residence schedule, release state and trade policies of one
+/// input commodity of a Conditioning facility with commodity_lanes. The
+/// first lane is held in the facility's own members, so only the others
+/// need one of these.
+class LaneState {
+ public:
+  LaneState() : head_bypass(0), held_credit(0), unreleased(0) {}
+
+  cyclus::toolkit::ResBuf<cyclus::Material> inventory;
+  cyclus::toolkit::ResBuf<cyclus::Material> processing;
+  cyclus::toolkit::ResBuf<cyclus::PackagedMaterial> packaged;
+  cyclus::toolkit::ResBuf<cyclus::PackagedMaterial> ready;
+  cyclus::toolkit::ResBuf<cyclus::PackagedMaterial> stocks;
+  ResidenceQueue schedule;
+  ReadyIndex ready_index;
+  int head_bypass;
+  double held_credit;
+  double unreleased;
+  cyclus::toolkit::MatlBuyPolicy buy_policy;
+  cyclus::toolkit::PackagedMatlSellPolicy sell_policy;
+};
+
+/// A view of the state one lane's material moves through, wherever it is
+/// held. Views are cheap to make and are only kept for one stage call.
+struct Lane {
+  Lane(cyclus::toolkit::ResBuf<cyclus::Material>& inventory,
+       cyclus::toolkit::ResBuf<cyclus::Material>& processing,
+       cyclus::toolkit::ResBuf<cyclus::PackagedMaterial>& packaged,
+       cyclus::toolkit::ResBuf<cyclus::PackagedMaterial>& ready,
+       cyclus::toolkit::ResBuf<cyclus::PackagedMaterial>& stocks,
+       ResidenceQueue& schedule, ReadyIndex& ready_index, int& head_bypass,
+       double& held_credit, double& unreleased, int index, double share)
+      : inventory(inventory),
+        processing(processing),
+        packaged(packaged),
+        ready(ready),
+        stocks(stocks),
+        schedule(schedule),
+        ready_index(ready_index),
+        head_bypass(head_bypass),
+        held_credit(held_credit),
+        unreleased(unreleased),
+        index(index),
+        share(share) {}
+
+  Lane(LaneState& s, int index, double share)
+      : inventory(s.inventory),
+        processing(s.processing),
+        packaged(s.packaged),
+        ready(s.ready),
+        stocks(s.stocks),
+        schedule(s.schedule),
+        ready_index(s.ready_index),
+        head_bypass(s.head_bypass),
+        held_credit(s.held_credit),
+        unreleased(s.unreleased),
+        index(index),
+        share(share) {}
+
+  /// @brief the quantity held across all of the lane's buffers (kg)
+  inline double quantity() const {
+    return inventory.quantity() + processing.quantity() +
+           packaged.quantity() + ready.quantity() + stocks.quantity();
+  }
+
+  /// @brief the quantity in stocks the sell policy may offer (kg)
+  inline double offered() const { return stocks.quantity() - unreleased; }
+
+  cyclus::toolkit::ResBuf<cyclus::Material>& inventory;
+  cyclus::toolkit::ResBuf<cyclus::Material>& processing;
+  cyclus::toolkit::ResBuf<cyclus::PackagedMaterial>& packaged;
+  cyclus::toolkit::ResBuf<cyclus::PackagedMaterial>& ready;
+  cyclus::toolkit::ResBuf<cyclus::PackagedMaterial>& stocks;
+  ResidenceQueue& schedule;
+  ReadyIndex& ready_index;
+  int& head_bypass;
+  double& held_credit;
+  double& unreleased;
+
+  /// the lane, in in_commods order
+  int index;
+
+  /// fraction of the facility's throughput and max_inv_size given to the
+  /// lane
+  double share;
+};
+
+/// A read-only view of a lane's buffers and residence schedule, for const
+/// members of the facility. Any Lane can be viewed as one.
+struct ConstLane {
+  ConstLane(const cyclus::toolkit::ResBuf<cyclus::Material>& inventory,
+            const cyclus::toolkit::ResBuf<cyclus::Material>& processing,
+            const cyclus::toolkit::ResBuf<cyclus::PackagedMaterial>& packaged,
+            const cyclus::toolkit::ResBuf<cyclus::PackagedMaterial>& ready,
+            const cyclus::toolkit::ResBuf<cyclus::PackagedMaterial>& stocks,
+            const ResidenceQueue& schedule, double unreleased, int index,
+            double share)
+      : inventory(inventory),
+        processing(processing),
+        packaged(packaged),
+        ready(ready),
+        stocks(stocks),
+        schedule(schedule),
+        unreleased(unreleased),
+        index(index),
+        share(share) {}
+
+  ConstLane(const LaneState& s, int index, double share)
+      : inventory(s.inventory),
+        processing(s.processing),
+        packaged(s.packaged),
+        ready(s.ready),
+        stocks(s.stocks),
+        schedule(s.schedule),
+        unreleased(s.unreleased),
+        index(index),
+        share(share) {}
+
+  ConstLane(const Lane& l)
+      : inventory(l.inventory),
+        processing(l.processing),
+        packaged(l.packaged),
+        ready(l.ready),
+        stocks(l.stocks),
+        schedule(l.schedule),
+        unreleased(l.unreleased),
+        index(l.index),
+        share(l.share) {}
+
+  /// @brief the quantity held across all of the lane's buffers (kg)
+  inline double quantity() const {
+    return inventory.quantity() + processing.quantity() +
+           packaged.quantity() + ready.quantity() + stocks.quantity();
+  }
+
+  const cyclus::toolkit::ResBuf<cyclus::Material>& inventory;
+  const cyclus::toolkit::ResBuf<cyclus::Material>& processing;
+  const cyclus::toolkit::ResBuf<cyclus::PackagedMaterial>& packaged;
+  const cyclus::toolkit::ResBuf<cyclus::PackagedMaterial>& ready;
+  const cyclus::toolkit::ResBuf<cyclus::PackagedMaterial>& stocks;
+  const ResidenceQueue& schedule;
+  double unreleased;
+  int index;
+  double share;
+};
+
+}  // namespace conditioning
+
+#endif  // CYDER_SRC_CONDITIONING_LANE_H_
@@ -0,0 +1,169 @@
+#ifndef CYDER_SRC_CONDITIONING_PROFILE_H_
+#define CYDER_SRC_CONDITIONING_PROFILE_H_
+
+#include <chrono>
+#include <string>
+
+#include "cyclus.h"
+
+namespace conditioning {
+
+/// The phases of a Conditioning timestep that are profiled.
+enum ProfilePhase {
+  /// setting the capacity requested from the buy policy
+  PHASE_TICK = 0,
+  /// batches received through the exchange. The buy policy accepts them
+  /// outside the agent, so they are only counted, as Tock starts, and the
+  /// phase takes no time.
+  PHASE_RECEIVE,
+  /// inventory to processing
+  PHASE_PROCESSING,
+  /// processing to packaged
+  PHASE_PACKAGING,
+  /// packaged, or inventory when passing through, to ready
+  PHASE_READY,
+  /// ready to stocks
+  PHASE_STOCKS,
+  N_PROFILE_PHASES
+};
+
+/// Totals for one phase. Allocations are only counted while AllocCounter
+/// is set.
+struct PhaseStats {
+  long calls;
+  long items;
+  long allocs;
+  double seconds;
+};
+
+/// @brief the process-wide heap allocation counter the profile reads, if
+/// any. Only an executable can count every allocation, by replacing
+/// operator new, so executables that do, such as the benchmarks, set this
+/// to a function returning their count. It is unset under the cyclus
+/// binary, which counts nothing.
+inline long (*&AllocCounter())() {
+  static long (*counter)() = NULL;
+  return counter;
+}
+
+/// @class Profile
+///
+/// Per-phase wall time, call, item and allocation totals for one agent. Use
+/// the CYDER_PROFILE_PHASE, CYDER_PROFILE_ITEMS and CYDER_PROFILE_COUNT
+/// macros rather than adding to it directly so that profiling compiles away
+/// entirely unless cyder is built with CYDER_PROFILE.
+class Profile {
+ public:
+  Profile() { Clear(); }
+
+  /// @brief the totals for a phase since the last Record or Clear
+  inline const PhaseStats& stats(ProfilePhase phase) const {
+    return stats_[phase];
+  }
+
+  /// @brief adds one call of a phase to its totals
+  inline void Add(ProfilePhase phase, double seconds, long items,
+                  long allocs = 0) {
+    stats_[phase].calls += 1;
+    stats_[phase].items += items;
+    stats_[phase].allocs += allocs;
+    stats_[phase].seconds += seconds;
+  }
+
+  /// @brief zeroes all totals
+  void Clear() {
+    for (int i = 0; i < N_PROFILE_PHASES; ++i) {
+      PhaseStats s = {0, 0, 0, 0.0};
+      stats_[i] = s;
+    }
+  }
+
+  /// @brief records a ConditioningProfile row for each phase that was
+  /// called, then zeroes the totals. The output database has no 64-bit
+  /// integer type, so counts are recorded as doubles, which hold them
+  /// exactly. Allocations are recorded as -1 if AllocCounter is unset.
+  void Record(cyclus::Agent* agent) {
+    static const char* names[N_PROFILE_PHASES] = {
+        "tick", "receive", "processing", "packaging", "ready", "stocks"};
+    for (int i = 0; i < N_PROFILE_PHASES; ++i) {
+      if (stats_[i].calls == 0) {
+        continue;
+      }
+      agent->context()
+          ->NewDatum("ConditioningProfile")
+          ->AddVal("AgentId", agent->id())
+          ->AddVal("Phase", std::string(names[i]))
+          ->AddVal("Calls", static_cast<double>(stats_[i].calls))
+          ->AddVal("Items", static_cast<double>(stats_[i].items))
+          ->AddVal("Allocs", AllocCounter() == NULL
+                                 ? -1.0
+                                 : static_cast<double>(stats_[i].allocs))
+          ->AddVal("Seconds", stats_[i].seconds)
+          ->Record();
+    }
+    Clear();
+  }
+
+ private:
+  PhaseStats stats_[N_PROFILE_PHASES];
+};
+
+/// @class ScopedPhase
+///
+/// Times a phase, and counts its allocations, from construction to the end
+/// of its scope.
+class ScopedPhase {
+ public:
+  ScopedPhase(Profile* profile, ProfilePhase phase)
+      : profile_(profile),
+        phase_(phase),
+        items_(0),
+        allocs_(AllocCounter() ? AllocCounter()() : 0),
+        start_(std::chrono::steady_clock::now()) {}
+
+  ~ScopedPhase() {
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start_;
+    long allocs = AllocCounter() ? AllocCounter()() - allocs_ : 0;
+    profile_->Add(phase_, elapsed.count(), items_, allocs);
+  }
+
+  /// @brief sets the number of items the phase moved
+  inline void items(long n) { items_ = n; }
+
+ private:
+  Profile* profile_;
+  ProfilePhase phase_;
+  long items_;
+  long allocs_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace conditioning
+
+/// Times the rest of the enclosing scope as a phase if profiling is compiled
+/// in. CYDER_PROFILE_ITEMS sets the number of items it moved and may only be
+/// used after CYDER_PROFILE_PHASE in the same scope. CYDER_PROFILE_COUNT
+/// adds a call that moved some items without timing anything. When
+/// profiling is compiled out, the profile is not named at all and item
+/// counts are only named inside sizeof, as with CYDER_TRACE_EVENT.
+#ifdef CYDER_PROFILE
+#define CYDER_PROFILE_PHASE(profile, phase) \
+  conditioning::ScopedPhase cyder_scoped_phase_(&(profile), phase)
+#define CYDER_PROFILE_ITEMS(n) cyder_scoped_phase_.items(n)
+#define CYDER_PROFILE_COUNT(profile, phase, n) (profile).Add(phase, 0.0, n)
+#else
+#define CYDER_PROFILE_PHASE(profile, phase) \
+  do {                                      \
+  } while (0)
+#define CYDER_PROFILE_ITEMS(n) \
+  do {                         \
+    (void)sizeof(n);           \
+  } while (0)
+#define CYDER_PROFILE_COUNT(profile, phase, n) \
+  do {                                         \
+    (void)sizeof(n);                           \
+  } while (0)
+#endif
+
+#endif  // CYDER_SRC_CONDITIONING_PROFILE_H_
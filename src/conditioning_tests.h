@@ -0,0 +1,351 @@
+#ifndef CYDER_SRC_CONDITIONING_TESTS_H_
+#define CYDER_SRC_CONDITIONING_TESTS_H_
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "conditioning.h"
+#include "context.h"
+#include "recorder.h"
+#include "sqlite_back.h"
+#include "timer.h"
+
+namespace conditioning {
+
+/// @class ConditioningTest
+///
+/// Drives a Conditioning facility directly against a bare context, with no
+/// simulation, exchange or database behind it. Material is handed to the
+/// facility as the buy policy would and taken from stocks as the sell policy
+/// would, so a timestep costs no more than the facility's own work. The
+/// unit tests and the benchmarks both use it.
+///
+/// Each timestep is Tick(), any number of AddMat() calls and then Tock().
+/// With invariant checks on, Tock() throws a cyclus::StateError if the
+/// facility has taken material beyond what max_inv_size allows or if
+/// material has been created or lost.
+class ConditioningTest {
+ public:
+  /// @param residence_time the facility's residence time (timesteps)
+  /// @param throughput the facility's throughput (kg per timestep)
+  /// @param discrete whether batches are handled discretely
+  ConditioningTest(int residence_time, double throughput, bool discrete)
+      : ctx_(&ti_, &rec_),
+        time_(0),
+        check_(true),
+        injected_(0),
+        drained_(0),
+        back_(NULL) {
+    fac_ = new Conditioning(&ctx_);
+    fac_->in_commods.push_back("in");
+    fac_->out_commods.push_back("out");
+    fac_->residence_time = residence_time;
+    fac_->throughput = throughput;
+    fac_->max_inv_size = 1e299;
+    fac_->discrete_handling = discrete;
+    fac_->MakeLanes_();
+  }
+
+  ~ConditioningTest() {
+    delete fac_;
+    if (back_ != NULL) {
+      rec_.Close();
+      delete back_;
+    }
+  }
+
+  /// @brief sets the facility's max_inv_size (kg)
+  void max_inv_size(double qty) { fac_->max_inv_size = qty; }
+
+  /// @brief sets the number of identical facilities the agent stands in for
+  void fleet_size(int n) { fac_->fleet_size = n; }
+
+  /// @brief sets whether discrete batches are selected to fill the
+  /// throughput rather than first in, first out
+  void fill_selection(bool on) {
+    fac_->discrete_selection = on ? "fill" : "fifo";
+    fac_->selection = on ? SELECT_FILL : SELECT_FIFO;
+  }
+
+  /// @brief sets how processed material is repackaged
+  /// @param strategy the package_strategy
+  /// @param fill_min the package_fill_min (kg)
+  /// @param fill_max the package_fill_max (kg)
+  void packaging(const std::string& strategy, double fill_min,
+                 double fill_max) {
+    fac_->package_strategy = strategy;
+    fac_->package_fill_min = fill_min;
+    fac_->package_fill_max = fill_max;
+  }
+
+  /// @brief sets whether batches are decayed as they are released
+  void decay_on_release(bool on) { fac_->decay_on_release = on; }
+
+  /// @brief sets how many timesteps a head batch may be bypassed
+  void max_bypass(int n) { fac_->max_bypass = n; }
+
+  /// @brief sets the facility's max_offers
+  void max_offers(int n) { fac_->max_offers = n; }
+
+  /// @brief the number of items held in a lane's stocks
+  int stocked_count(int lane = 0) const {
+    return fac_->lane(lane).stocks.count(); }
+
+  /// @brief sets whether continuous batches are only split when traded
+  void lazy_split(bool on) { fac_->lazy_split = on; }
+
+  /// @brief sets the unit requests are rounded down to (kg)
+  void request_quantum(double qty) { fac_->request_quantum = qty; }
+
+  /// @brief sets whether continuous batches of one composition are merged
+  /// as they arrive
+  void merge_materials(bool on) { fac_->merge_materials = on; }
+
+  /// @brief sets whether the facility sizes requests with look-ahead
+  void lookahead_requests(bool on) { fac_->lookahead_requests = on; }
+
+  /// @brief sets whether Tock checks invariants
+  void check_invariants(bool on) { check_ = on; }
+
+  /// @brief gives the facility commodity lanes, one for each share
+  /// @param shares each lane's relative share of throughput and
+  /// max_inv_size
+  void lanes(const std::vector<double>& shares) {
+    fac_->commodity_lanes = true;
+    fac_->in_commods.clear();
+    fac_->out_commods.clear();
+    for (int i = 0; i < shares.size(); ++i) {
+      std::stringstream ss;
+      ss << i;
+      fac_->in_commods.push_back("in" + ss.str());
+      fac_->out_commods.push_back("out" + ss.str());
+    }
+    fac_->lane_shares = shares;
+    fac_->MakeLanes_();
+  }
+
+  /// @brief the timestep the next Tock runs
+  int time() const { return time_; }
+
+  /// @brief the earliest timestep, from the next Tock on, at which a lane
+  /// has work, or -1 if it has none pending. Tock skips the lane until then.
+  int next_event(int lane = 0) const {
+    const Conditioning* fac = fac_;
+    return fac->NextEventTime_(fac->lane(lane), time_);
+  }
+
+  /// @brief the quantity a lane still has room for this timestep (kg), as
+  /// set by the last Tick
+  double room(int lane = 0) const {
+    return fac_->lane(lane).inventory.space(); }
+
+  /// @brief the quantity held in a lane's stocks (kg)
+  double stocked(int lane = 0) const {
+    return fac_->lane(lane).stocks.quantity(); }
+
+  /// @brief the quantity a lane's sell policy may offer (kg)
+  double offered(int lane = 0) const { return fac_->lane(lane).offered(); }
+
+  /// @brief the quantity of each item in a lane's stocks (kg), oldest first
+  std::vector<double> stocked_items(int lane = 0) const {
+    std::vector<cyclus::PackagedMaterial::Ptr> items = Stocks_(lane);
+    std::vector<double> qtys;
+    for (int i = 0; i < items.size(); ++i) {
+      qtys.push_back(items[i]->quantity());
+    }
+    return qtys;
+  }
+
+  /// @brief the composition of each item in a lane's stocks, oldest first
+  std::vector<cyclus::Composition::Ptr> stocked_comps(int lane = 0) const {
+    std::vector<cyclus::PackagedMaterial::Ptr> items = Stocks_(lane);
+    std::vector<cyclus::Composition::Ptr> comps;
+    for (int i = 0; i < items.size(); ++i) {
+      comps.push_back(items[i]->comp());
+    }
+    return comps;
+  }
+
+  /// @brief the number of packages held for residence time in a lane
+  int packaged_count(int lane = 0) const {
+    return fac_->lane(lane).packaged.count(); }
+
+  /// @brief the quantity waiting in a lane's processing buffer (kg)
+  double processing(int lane = 0) const {
+    return fac_->lane(lane).processing.quantity(); }
+
+#ifdef CYDER_PROFILE
+  /// @brief the facility's per-phase totals
+  const Profile& phase_profile() const { return fac_->phase_profile(); }
+
+#endif
+  /// @brief the quantity handed to the facility so far (kg)
+  double injected() const { return injected_; }
+
+  /// @brief the quantity taken from stocks so far (kg)
+  double drained() const { return drained_; }
+
+  /// @brief the quantity held across all buffers of all lanes (kg)
+  double held() const {
+    double qty = 0;
+    for (int i = 0; i < fac_->n_lanes(); ++i) {
+      qty += fac_->lane(i).quantity();
+    }
+    return qty;
+  }
+
+  /// @brief the facility's AgentId
+  int id() const { return fac_->id(); }
+
+  /// @brief a batch recorded in the output, as one received in trade would
+  /// be, so that it can be built again from a snapshot
+  cyclus::Material::Ptr Tracked(double qty, cyclus::Composition::Ptr comp) {
+    return cyclus::Material::Create(fac_, qty, comp);
+  }
+
+  /// @brief records the output to a SQLite database from now on
+  void Record(const std::string& path) {
+    back_ = new cyclus::SqliteBack(path);
+    rec_.RegisterBackend(back_);
+  }
+
+  /// @brief records the facility's state and inventories as a simulation
+  /// snapshot does, then writes out everything recorded so far
+  void Snapshot() {
+    fac_->Snapshot(cyclus::DbInit(fac_));
+    cyclus::Inventories invs = fac_->SnapshotInv();
+    cyclus::Inventories::iterator it;
+    for (it = invs.begin(); it != invs.end(); ++it) {
+      for (int i = 0; i < it->second.size(); ++i) {
+        ctx_.NewDatum("AgentStateInventories")
+            ->AddVal("AgentId", fac_->id())
+            ->AddVal("SimTime", ctx_.time())
+            ->AddVal("InventoryName", it->first)
+            ->AddVal("ResourceId", it->second[i]->state_id())
+            ->Record();
+      }
+    }
+    rec_.Flush();
+  }
+
+  /// @brief replaces the facility with one built from its snapshot, as
+  /// restarting a simulation from that snapshot would
+  void Restart() {
+    fac_->Snapshot(cyclus::DbInit(fac_));
+    cyclus::Inventories invs = fac_->SnapshotInv();
+    Conditioning* fac = dynamic_cast<Conditioning*>(fac_->Clone());
+    fac->InitInv(invs);
+    // EnterNotify resolves discrete_selection as the simulation restarts
+    fac->selection = fac_->selection;
+    delete fac_;
+    fac_ = fac;
+  }
+
+  /// @brief fills the facility from a snapshot of another, as building it
+  /// with warm_start_db and warm_start_agent would
+  void WarmStart(const std::string& path, int agent) {
+    double held_before = held();
+    fac_->warm_start_db = path;
+    fac_->warm_start_agent = agent;
+    fac_->WarmStart_();
+    injected_ += held() - held_before;
+  }
+
+  /// @brief runs Tick for the next timestep
+  void Tick() { fac_->Tick(); }
+
+  /// @brief places a batch in a lane's inventory, as the buy policy would
+  void AddMat(cyclus::Material::Ptr mat, int lane = 0) {
+    injected_ += mat->quantity();
+    fac_->AddMat_(mat, lane);
+  }
+
+  /// @brief runs Tock for the next timestep
+  void Tock() {
+    if (check_) {
+      CheckCapacity_();
+    }
+    fac_->Step_(time_++);
+    if (check_) {
+      CheckMass_();
+    }
+  }
+
+  /// @brief runs Tick and Tock for the next timestep
+  void Step() {
+    Tick();
+    Tock();
+  }
+
+  /// @brief takes material from stocks, oldest first, as the sell policy
+  /// would if offers were accepted in order
+  /// @param qty the most to take (kg), all that is offered by default
+  /// @return the quantity taken (kg)
+  double Drain(double qty = 1e299) {
+    double taken = std::min(qty, offered());
+    if (taken >= fac_->stocks.quantity()) {
+      fac_->stocks.PopN(fac_->stocks.count());
+    } else if (taken > 0) {
+      fac_->stocks.Pop(taken, cyclus::eps_rsrc());
+    }
+    drained_ += taken;
+    return taken;
+  }
+
+ private:
+  std::vector<cyclus::PackagedMaterial::Ptr> Stocks_(int lane) const {
+    Lane l = fac_->lane(lane);
+    std::vector<cyclus::PackagedMaterial::Ptr> items =
+        l.stocks.PopN(l.stocks.count());
+    l.stocks.Push(items);
+    return items;
+  }
+
+  void CheckCapacity_() const {
+    // material may only be taken while what Tick counts against each
+    // lane's share of max_inv_size leaves room for it
+    for (int i = 0; i < fac_->n_lanes(); ++i) {
+      Lane l = fac_->lane(i);
+      double counted = l.inventory.quantity() + l.processing.quantity() +
+                       l.offered();
+      if (fac_->lookahead_requests) {
+        counted += l.packaged.quantity() + l.ready.quantity() + l.unreleased;
+      }
+      double limit = l.share * fac_->fleet_max_inv_size();
+      if (!l.inventory.empty() && counted > limit + cyclus::eps_rsrc()) {
+        std::stringstream ss;
+        ss << "at time " << time_ << " lane " << i << " holds " << counted
+           << " kg, more than its limit of " << limit;
+        throw cyclus::StateError(ss.str());
+      }
+    }
+  }
+
+  void CheckMass_() const {
+    double expected = injected_ - drained_;
+    double tol = cyclus::eps_rsrc() * std::max(1.0, injected_);
+    if (std::fabs(held() - expected) > tol) {
+      std::stringstream ss;
+      ss << "at time " << time_ - 1 << " the facility holds " << held()
+         << " kg, expected " << expected;
+      throw cyclus::StateError(ss.str());
+    }
+  }
+
+  cyclus::Timer ti_;
+  cyclus::Recorder rec_;
+  cyclus::Context ctx_;
+  Conditioning* fac_;
+  int time_;
+  bool check_;
+  double injected_;
+  double drained_;
+  cyclus::SqliteBack* back_;
+};
+
+}  // namespace conditioning
+
+#endif  // CYDER_SRC_CONDITIONING_TESTS_H_
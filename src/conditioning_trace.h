@@ -0,0 +1,125 @@
+#ifndef CYDER_SRC_CONDITIONING_TRACE_H_
+#define CYDER_SRC_CONDITIONING_TRACE_H_
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "cyclus.h"
+
+namespace conditioning {
+
+/// Trace verbosity levels, from least to most verbose.
+enum TraceLevel {
+  /// nothing is traced
+  TRACE_OFF = 0,
+  /// one event per stage move per timestep
+  TRACE_STAGE = 1,
+  /// additionally one event per received batch
+  TRACE_BATCH = 2
+};
+
+/// A single traced event. Event names are string literals so recording one
+/// never allocates.
+struct TraceEvent {
+  int time;
+  const char* event;
+  int count;
+  double quantity;
+};
+
+/// @class Trace
+///
+/// A buffered, level-gated event stream for one agent. Events are held in
+/// memory and written out in blocks, either to the ConditioningTrace table or,
+/// if a path is given, appended to a CSV file. Use the CYDER_TRACE_EVENT macro
+/// rather than calling Add directly so that tracing compiles away entirely
+/// unless cyder is built with CYDER_TRACE.
+class Trace {
+ public:
+  Trace() : level_(TRACE_OFF) {}
+
+  /// @brief sets the verbosity and destination of the trace
+  /// @param level the highest TraceLevel that is recorded
+  /// @param path file to append events to, or empty for the output database
+  void Init(int level, const std::string& path) {
+    level_ = level;
+    path_ = path;
+    events_.reserve(kBlockSize);
+  }
+
+  /// @brief true if events at this level are recorded
+  inline bool enabled(int level) const { return level <= level_; }
+
+  /// @brief number of buffered events that have not been written yet
+  inline int size() const { return events_.size(); }
+
+  /// @brief buffers an event, writing a full block out if needed
+  inline void Add(cyclus::Agent* agent, int time, const char* event, int count,
+                  double quantity) {
+    TraceEvent e = {time, event, count, quantity};
+    events_.push_back(e);
+    if (events_.size() >= kBlockSize) {
+      Flush(agent);
+    }
+  }
+
+  /// @brief writes out and clears all buffered events
+  void Flush(cyclus::Agent* agent) {
+    if (events_.empty()) {
+      return;
+    }
+
+    std::vector<TraceEvent>::const_iterator it;
+    if (path_.empty()) {
+      for (it = events_.begin(); it != events_.end(); ++it) {
+        agent->context()
+            ->NewDatum("ConditioningTrace")
+            ->AddVal("AgentId", agent->id())
+            ->AddVal("Time", it->time)
+            ->AddVal("Event", std::string(it->event))
+            ->AddVal("Count", it->count)
+            ->AddVal("Quantity", it->quantity)
+            ->Record();
+      }
+    } else {
+      std::ofstream out(path_.c_str(), std::ios::app);
+      if (!out) {
+        throw cyclus::IOError("could not open trace file " + path_);
+      }
+      for (it = events_.begin(); it != events_.end(); ++it) {
+        out << agent->id() << "," << it->time << "," << it->event << ","
+            << it->count << "," << it->quantity << "\n";
+      }
+    }
+    events_.clear();
+  }
+
+ private:
+  static const size_t kBlockSize = 4096;
+
+  std::vector<TraceEvent> events_;
+  int level_;
+  std::string path_;
+};
+
+}  // namespace conditioning
+
+/// Records a trace event if tracing is compiled in and the level is enabled.
+/// Arguments are not evaluated otherwise; when tracing is compiled out the
+/// count and quantity are only named inside sizeof so locals computed for the
+/// trace do not trigger unused variable warnings.
+#ifdef CYDER_TRACE
+#define CYDER_TRACE_EVENT(trace, level, agent, time, event, count, quantity) \
+  if (!(trace).enabled(level)) {                                             \
+  } else                                                                     \
+    (trace).Add(agent, time, event, count, quantity)
+#else
+#define CYDER_TRACE_EVENT(trace, level, agent, time, event, count, quantity) \
+  do {                                                                       \
+    (void)sizeof(count);                                                     \
+    (void)sizeof(quantity);                                                  \
+  } while (0)
+#endif
+
+#endif  // CYDER_SRC_CONDITIONING_TRACE_H_
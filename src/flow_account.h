@@ -0,0 +1,178 @@
+#ifndef CYDER_SRC_FLOW_ACCOUNT_H_
+#define CYDER_SRC_FLOW_ACCOUNT_H_
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "cyclus.h"
+
+namespace conditioning {
+
+/// The stage transitions that are accounted for, named by the buffer that
+/// material moves into.
+enum FlowStage {
+  FLOW_PROCESSING = 0,
+  FLOW_PACKAGED,
+  FLOW_READY,
+  FLOW_STOCKS,
+  N_FLOW_STAGES
+};
+
+/// @class FlowAccount
+///
+/// Running per-stage totals of the material and batches a facility moves,
+/// and a histogram of how long batches take from packaging to stocks. Adding
+/// to the totals costs a few additions per stage move; they are written out
+/// as a single ConditioningFlows row per reporting period.
+class FlowAccount {
+ public:
+  FlowAccount() : start_(0) { Reset_(); }
+
+  /// @brief counts material moved into a stage
+  /// @param stage the stage the material moved into
+  /// @param n the number of batches moved
+  /// @param qty the quantity moved (kg)
+  inline void Add(FlowStage stage, int n, double qty) {
+    counts_[stage] += n;
+    qtys_[stage] += qty;
+  }
+
+  /// @brief notes batches entering a lane's ready buffer
+  /// @param lane the lane
+  /// @param time the current time
+  /// @param n the number of batches
+  inline void Readied(int lane, int time, int n) {
+    if (n <= 0) {
+      return;
+    }
+    if (static_cast<int>(ready_.size()) <= lane) {
+      ready_.resize(lane + 1);
+    }
+    std::deque<std::pair<int, int> >& q = ready_[lane];
+    if (!q.empty() && q.back().first == time) {
+      q.back().second += n;
+    } else {
+      q.push_back(std::make_pair(time, n));
+    }
+  }
+
+  /// @brief notes the oldest batches in a lane's ready buffer leaving for
+  /// stocks and adds their holdup time to the histogram. Batches that leave
+  /// out of order, as with 'fill' selection, are counted as the oldest ones.
+  /// @param lane the lane
+  /// @param time the current time
+  /// @param n the number of batches
+  /// @param residence_time the residence time they were held for before
+  /// becoming ready
+  inline void Stocked(int lane, int time, int n, int residence_time) {
+    if (static_cast<int>(ready_.size()) <= lane) {
+      return;
+    }
+    std::deque<std::pair<int, int> >& q = ready_[lane];
+    while (n > 0 && !q.empty()) {
+      int k = std::min(n, q.front().second);
+      holdup_[time - q.front().first + residence_time] += k;
+      q.front().second -= k;
+      n -= k;
+      if (q.front().second == 0) {
+        q.pop_front();
+      }
+    }
+  }
+
+  /// @brief the first timestep of the current reporting period
+  inline int start() const { return start_; }
+
+  /// @brief the holdup histogram of the current reporting period
+  inline const std::map<int, int>& holdup() const { return holdup_; }
+
+  /// @brief the batches in each lane's ready buffer, for a snapshot
+  /// @return (lane, time readied, number of batches) triples, oldest first
+  /// within each lane
+  std::vector<int> ready() const {
+    std::vector<int> encoded;
+    for (int i = 0; i < ready_.size(); ++i) {
+      std::deque<std::pair<int, int> >::const_iterator it;
+      for (it = ready_[i].begin(); it != ready_[i].end(); ++it) {
+        encoded.push_back(i);
+        encoded.push_back(it->first);
+        encoded.push_back(it->second);
+      }
+    }
+    return encoded;
+  }
+
+  /// @brief restores the reporting period and ready batches from a
+  /// snapshot
+  /// @param start the first timestep of the current reporting period
+  /// @param ready the ready batches, as returned by ready()
+  /// @param shift added to each time readied
+  void Load(int start, const std::vector<int>& ready, int shift = 0) {
+    start_ = start;
+    ready_.clear();
+    for (int i = 0; i + 2 < ready.size(); i += 3) {
+      Readied(ready[i], ready[i + 1] + shift, ready[i + 2]);
+    }
+  }
+
+  /// @brief records the totals since the last report and starts a new
+  /// reporting period
+  /// @param agent the facility the totals belong to
+  /// @param time the last timestep of the period
+  /// @param fleet_size the number of facilities the agent stands in for
+  /// @param occupancy the quantity held in the inventory, processing,
+  /// packaged, ready and stocks buffers at the end of the period (kg)
+  void Record(cyclus::Agent* agent, int time, int fleet_size,
+              const double occupancy[5]) {
+    agent->context()
+        ->NewDatum("ConditioningFlows")
+        ->AddVal("AgentId", agent->id())
+        ->AddVal("StartTime", start_)
+        ->AddVal("EndTime", time)
+        ->AddVal("FleetSize", fleet_size)
+        ->AddVal("ProcessingQty", qtys_[FLOW_PROCESSING])
+        ->AddVal("ProcessingCount", counts_[FLOW_PROCESSING])
+        ->AddVal("PackagedQty", qtys_[FLOW_PACKAGED])
+        ->AddVal("PackagedCount", counts_[FLOW_PACKAGED])
+        ->AddVal("ReadyQty", qtys_[FLOW_READY])
+        ->AddVal("ReadyCount", counts_[FLOW_READY])
+        ->AddVal("StocksQty", qtys_[FLOW_STOCKS])
+        ->AddVal("StocksCount", counts_[FLOW_STOCKS])
+        ->AddVal("InventoryHeld", occupancy[0])
+        ->AddVal("ProcessingHeld", occupancy[1])
+        ->AddVal("PackagedHeld", occupancy[2])
+        ->AddVal("ReadyHeld", occupancy[3])
+        ->AddVal("StocksHeld", occupancy[4])
+        ->AddVal("HoldupHistogram", holdup_)
+        ->Record();
+    start_ = time + 1;
+    Reset_();
+  }
+
+ private:
+  void Reset_() {
+    for (int i = 0; i < N_FLOW_STAGES; ++i) {
+      counts_[i] = 0;
+      qtys_[i] = 0;
+    }
+    holdup_.clear();
+  }
+
+  int start_;
+  int counts_[N_FLOW_STAGES];
+  double qtys_[N_FLOW_STAGES];
+
+  /// batches in each lane's ready buffer, as (time readied, count) in FIFO
+  /// order
+  std::vector<std::deque<std::pair<int, int> > > ready_;
+
+  /// timesteps from packaging to stocks -> number of batches
+  std::map<int, int> holdup_;
+};
+
+}  // namespace conditioning
+
+#endif  // CYDER_SRC_FLOW_ACCOUNT_H_
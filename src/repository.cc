@@ -0,0 +1,280 @@
+// repository.cc
+// Implements the Repository class
+#include "repository.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "pyne.h"
+
+namespace repository {
+
+/// the most compositions whose decay heat is kept in heat_cache
+static const int kMaxHeatCache = 10000;
+
+/// energy of one MeV (J)
+static const double kJoulesPerMeV = 1.602176634e-13;
+
+/// Avogadro's number (1/mol)
+static const double kAvogadro = 6.02214076e23;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// the same defaults as the state variable pragmas in repository.h
+Repository::Repository(cyclus::Context* ctx)
+    : cyclus::Facility(ctx),
+      max_inv_size(1e299),
+      emplacement_rate(1000000),
+      n_drifts(0),
+      positions_per_drift(0),
+      drift_spacing(0.0),
+      package_spacing(0.0),
+      drift_radius(2.5),
+      conductivity(2.0),
+      thermal_cutoff(100.0),
+      ambient_temperature(25.0),
+      drift_temperature_limit(200.0),
+      pillar_temperature_limit(100.0),
+      next_slot(0),
+      field_loaded(false),
+      latitude(0.0),
+      longitude(0.0),
+      coordinates(latitude, longitude) {
+  cyclus::Warn<cyclus::EXPERIMENTAL_WARNING>(
+      "The Repository Facility is experimental.");
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// pragmas
+
+#pragma cyclus def schema repository::Repository
+
+#pragma cyclus def annotations repository::Repository
+
+#pragma cyclus def initinv repository::Repository
+
+#pragma cyclus def snapshotinv repository::Repository
+
+#pragma cyclus def infiletodb repository::Repository
+
+#pragma cyclus def snapshot repository::Repository
+
+#pragma cyclus def clone repository::Repository
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Repository::InitFrom(Repository* m) {
+#pragma cyclus impl initfromcopy repository::Repository
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Repository::InitFrom(cyclus::QueryableBackend* b) {
+#pragma cyclus impl initfromdb repository::Repository
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Repository::EnterNotify() {
+  cyclus::Facility::EnterNotify();
+
+  if (n_drifts < 1 || positions_per_drift < 1) {
+    std::stringstream ss;
+    ss << "the repository needs at least one drift and position, got "
+       << n_drifts << " drifts of " << positions_per_drift << " positions";
+    throw cyclus::ValueError(ss.str());
+  }
+  if (drift_spacing <= 0 || package_spacing <= 0 || drift_radius <= 0 ||
+      conductivity <= 0) {
+    throw cyclus::ValueError("drift_spacing, package_spacing, drift_radius "
+                             "and conductivity must be positive");
+  }
+  if (drift_temperature_limit < ambient_temperature ||
+      pillar_temperature_limit < ambient_temperature) {
+    throw cyclus::ValueError("temperature limits must not be below the "
+                             "ambient temperature");
+  }
+
+  buy_policy.Init(this, &waiting, std::string("waiting"));
+
+  // accept any composition
+  cyclus::CompMap v;
+  cyclus::Composition::Ptr comp = cyclus::Composition::CreateFromAtom(v);
+
+  if (in_commod_prefs.size() == 0) {
+    for (int i = 0; i < in_commods.size(); ++i) {
+      in_commod_prefs.push_back(cyclus::kDefaultPref);
+    }
+  } else if (in_commod_prefs.size() != in_commods.size()) {
+    std::stringstream ss;
+    ss << "in_commod_prefs has " << in_commod_prefs.size()
+       << " values, expected " << in_commods.size();
+    throw cyclus::ValueError(ss.str());
+  }
+
+  for (int i = 0; i != in_commods.size(); ++i) {
+    buy_policy.Set(in_commods[i], comp, in_commod_prefs[i]);
+  }
+  buy_policy.Start();
+
+  RecordPosition();
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+std::string Repository::str() {
+  std::stringstream ss;
+  ss << cyclus::Facility::str();
+  ss << " has facility parameters {"
+     << "\n"
+     << "     Drifts = " << n_drifts << ",\n"
+     << "     Positions per Drift = " << positions_per_drift << ",\n"
+     << "     Emplaced = " << next_slot << ",\n"
+     << "     Drift Temperature Limit = " << drift_temperature_limit << ",\n"
+     << "     Pillar Temperature Limit = " << pillar_temperature_limit
+     << "'}";
+  return ss.str();
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Repository::Tick() {
+  // Set available capacity for Buy Policy; nothing is requested once the
+  // repository is full
+  if (next_slot < n_drifts * positions_per_drift) {
+    waiting.capacity(std::max(waiting.quantity(), max_inv_size));
+  } else {
+    waiting.capacity(waiting.quantity());
+  }
+
+  LOG(cyclus::LEV_INFO3, "Repo") << prototype() << " is ticking {";
+  LOG(cyclus::LEV_INFO4, "Repo") << " has " << waiting.count()
+                                 << " packages waiting to be emplaced.";
+  LOG(cyclus::LEV_INFO3, "Repo") << "}";
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Repository::Tock() {
+  LOG(cyclus::LEV_INFO3, "Repo") << prototype() << " is tocking {";
+
+  if (!field_loaded) {
+    LoadField_();
+  }
+  Emplace_(context()->time());
+
+  LOG(cyclus::LEV_INFO4, "Repo") << " has emplaced " << next_slot
+                                 << " packages.";
+  LOG(cyclus::LEV_INFO3, "Repo") << "}";
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Repository::Emplace_(int time) {
+  using cyclus::Material;
+
+  double t = seconds(time);
+  double drift_limit = drift_temperature_limit - ambient_temperature;
+  double pillar_limit = pillar_temperature_limit - ambient_temperature;
+  int n_slots = n_drifts * positions_per_drift;
+
+  try {
+    for (int n = 0;
+         n < emplacement_rate && !waiting.empty() && next_slot < n_slots;
+         ++n) {
+      ThermalField::Heat heat = PackageHeat_(waiting.Peek());
+      if (!field.Fits(next_slot, heat, t, drift_limit, pillar_limit)) {
+        break;  // wait for the repository to cool
+      }
+
+      Material::Ptr mat = waiting.Pop();
+      field.Add(next_slot, heat, t);
+      emplaced.Push(mat);
+      emplaced_times.push_back(time);
+      emplaced_heat.insert(emplaced_heat.end(), heat.begin(), heat.end());
+
+      context()
+          ->NewDatum("RepositoryEmplacement")
+          ->AddVal("AgentId", id())
+          ->AddVal("Time", time)
+          ->AddVal("ResourceId", mat->obj_id())
+          ->AddVal("Drift", next_slot / positions_per_drift)
+          ->AddVal("Position", next_slot % positions_per_drift)
+          ->AddVal("Quantity", mat->quantity())
+          ->AddVal("DecayHeat", ThermalField::Power(heat, 0))
+          ->AddVal("DriftTemperature",
+                   ambient_temperature + field.drift_temperature(next_slot, t))
+          ->AddVal("PillarTemperature",
+                   ambient_temperature +
+                       field.pillar_temperature(next_slot, t))
+          ->Record();
+      ++next_slot;
+    }
+  } catch (cyclus::Error& e) {
+    e.msg(Agent::InformErrorMsg(e.msg()));
+    throw e;
+  }
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+ThermalField::Heat Repository::PackageHeat_(cyclus::Material::Ptr mat) {
+  cyclus::Composition::Ptr comp = mat->comp();
+
+  // packages made to one recipe share a composition and others rarely repeat
+  // one, so the cache starts afresh once it is full
+  if (heat_cache.size() > kMaxHeatCache) {
+    heat_cache.clear();
+  }
+
+  std::map<int, ThermalField::Heat>::iterator it = heat_cache.find(comp->id());
+  if (it == heat_cache.end()) {
+    // decay heat of each nuclide in 1 kg is N lambda Q
+    ThermalField::Heat per_kg(ThermalField::kGroups, 0.0);
+    const cyclus::CompMap& mass = comp->mass();
+    cyclus::CompMap::const_iterator nuc;
+    for (nuc = mass.begin(); nuc != mass.end(); ++nuc) {
+      double lambda = pyne::decay_const(nuc->first);
+      if (lambda <= 0 || nuc->second <= 0) {
+        continue;
+      }
+      double atoms = nuc->second * 1000 / pyne::atomic_mass(nuc->first) *
+                     kAvogadro;
+      per_kg[ThermalField::group(lambda)] +=
+          atoms * lambda * pyne::q_val(nuc->first) * kJoulesPerMeV;
+    }
+    it = heat_cache.insert(std::make_pair(comp->id(), per_kg)).first;
+  }
+
+  ThermalField::Heat heat(it->second);
+  for (int g = 0; g < ThermalField::kGroups; ++g) {
+    heat[g] *= mat->quantity();
+  }
+  return heat;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Repository::LoadField_() {
+  field.Init(n_drifts, positions_per_drift, drift_spacing, package_spacing,
+             drift_radius, conductivity, thermal_cutoff);
+
+  // packages were emplaced in slot order
+  for (int i = 0; i < emplaced_times.size(); ++i) {
+    std::vector<double>::const_iterator heat =
+        emplaced_heat.begin() + i * ThermalField::kGroups;
+    field.Add(i, ThermalField::Heat(heat, heat + ThermalField::kGroups),
+              seconds(emplaced_times[i]));
+  }
+  field_loaded = true;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Repository::RecordPosition() {
+  std::string specification = this->spec();
+  context()
+      ->NewDatum("AgentPosition")
+      ->AddVal("Spec", specification)
+      ->AddVal("Prototype", this->prototype())
+      ->AddVal("AgentId", id())
+      ->AddVal("Latitude", latitude)
+      ->AddVal("Longitude", longitude)
+      ->Record();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+extern "C" cyclus::Agent* ConstructRepository(cyclus::Context* ctx) {
+  return new Repository(ctx);
+}
+
+}  // namespace repository
@@ -0,0 +1,276 @@
+#ifndef CYDER_SRC_REPOSITORY_H_
+#define CYDER_SRC_REPOSITORY_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "cyclus.h"
+#include "cyder_version.h"
+#include "thermal_field.h"
+
+namespace repository {
+
+/// @class Repository
+///
+/// This Facility emplaces waste packages in a geologic repository laid out
+/// as parallel drifts, as long as doing so keeps the drift walls and the rock
+/// pillars between drifts below their temperature limits.
+///
+/// @section agentparams Agent Parameters
+/// in_commods is a vector of strings naming the commodities that this
+/// facility receives, typically packages from Conditioning
+/// n_drifts, positions_per_drift, drift_spacing and package_spacing describe
+/// the repository layout
+///
+/// @section optionalparams Optional Parameters
+/// max_inv_size is the most material that may wait to be emplaced
+/// emplacement_rate is the most packages emplaced per timestep
+/// conductivity, drift_radius and thermal_cutoff describe heat conduction
+/// ambient_temperature, drift_temperature_limit and
+/// pillar_temperature_limit give the temperature limits
+///
+/// @section detailed Detailed Behavior
+///
+/// Tick:
+/// Requests as much material as can wait to be emplaced, or nothing once
+/// every package position is filled.
+///
+/// Tock:
+/// Waiting packages are emplaced in the order they were received, filling
+/// each drift in turn. The decay heat of each package is worked out from its
+/// composition. If emplacing the next package would take any temperature
+/// past its limit, it and every package behind it wait for the repository to
+/// cool.
+///
+/// Making Requests:
+/// This facility requests all of the in_commods that it can hold.
+///
+/// Receiving Resources:
+/// Received packages wait to be emplaced.
+///
+/// Making Offers:
+/// Emplaced material is never offered.
+class Repository : public cyclus::Facility,
+                   public cyclus::toolkit::Position {
+ public:
+  /// @param ctx the cyclus context for access to simulation-wide parameters
+  Repository(cyclus::Context* ctx);
+
+  #pragma cyclus decl
+
+  #pragma cyclus note {"doc": "Repository emplaces waste packages in parallel drifts of equally "\
+                              "spaced positions, filling one drift after the other. A package is "\
+                              "only emplaced if the temperature rise from the decay heat of every "\
+                              "package emplaced so far, and its own, keeps the drift walls and the "\
+                              "rock pillars between drifts within their limits. Otherwise packages "\
+                              "wait for the repository to cool. Decay heat is worked out from each "\
+                              "package's composition when it is emplaced, and heat is conducted "\
+                              "quasi-statically from each package as from a point source."}
+
+  /// A verbose printer for the Repository Facility
+  virtual std::string str();
+
+  // --- Agent Members ---
+  /// Sets up the Repository Facility's trade requests
+  virtual void EnterNotify();
+
+  /// The handleTick function specific to the Repository.
+  virtual void Tick();
+
+  /// The handleTock function specific to the Repository.
+  virtual void Tock();
+
+ protected:
+  /// @brief emplaces as many waiting packages as the temperature limits and
+  /// emplacement rate allow
+  /// @param time the current time
+  void Emplace_(int time);
+
+  /// @brief the decay heat of a package in each heat group
+  /// @param mat the package
+  /// @return its heat (W)
+  ThermalField::Heat PackageHeat_(cyclus::Material::Ptr mat);
+
+  /// @brief sets up the thermal field and adds every package emplaced
+  /// before a restart
+  void LoadField_();
+
+  /// @brief the time at the start of a timestep (s)
+  inline double seconds(int time) const {
+    return static_cast<double>(time) * context()->dt(); }
+
+  /* --- Module Members --- */
+
+  #pragma cyclus var {"tooltip":"input commodity",\
+                      "doc":"commodities accepted by this facility",\
+                      "uilabel":"Input Commodities",\
+                      "uitype":["oneormore","incommodity"]}
+  std::vector<std::string> in_commods;
+
+  #pragma cyclus var {"default": [],\
+                      "doc":"preferences for each of the given commodities, in the same order. "\
+                      "Defauts to 1 if unspecified",\
+                      "uilabel":"In Commody Preferences", \
+                      "range": [None, [1e-299, 1e299]], \
+                      "uitype":["oneormore", "range"]}
+  std::vector<double> in_commod_prefs;
+
+  #pragma cyclus var {"default": 1e299,\
+                      "tooltip":"maximum waiting inventory size (kg)",\
+                      "doc":"the most material that may wait to be emplaced",\
+                      "uilabel":"Maximum Inventory Size",\
+                      "uitype": "range", \
+                      "range": [0.0, 1e299], \
+                      "units":"kg"}
+  double max_inv_size;
+
+  #pragma cyclus var {"default": 1000000,\
+                      "tooltip":"packages emplaced per timestep",\
+                      "doc":"the most packages that may be emplaced in one timestep",\
+                      "uilabel":"Emplacement Rate",\
+                      "uitype": "range", \
+                      "range": [1, 1000000]}
+  int emplacement_rate;
+
+  #pragma cyclus var {"tooltip":"number of drifts",\
+                      "doc":"number of parallel drifts in the repository",\
+                      "uilabel":"Number of Drifts",\
+                      "uitype": "range", \
+                      "range": [1, 100000]}
+  int n_drifts;
+
+  #pragma cyclus var {"tooltip":"package positions per drift",\
+                      "doc":"number of equally spaced package positions along each drift",\
+                      "uilabel":"Positions per Drift",\
+                      "uitype": "range", \
+                      "range": [1, 100000]}
+  int positions_per_drift;
+
+  #pragma cyclus var {"tooltip":"distance between drifts (m)",\
+                      "doc":"distance between the centres of neighbouring drifts",\
+                      "uilabel":"Drift Spacing",\
+                      "uitype": "range", \
+                      "range": [0.0, 1e4], \
+                      "units":"m"}
+  double drift_spacing;
+
+  #pragma cyclus var {"tooltip":"distance between packages (m)",\
+                      "doc":"distance between neighbouring package positions along a drift",\
+                      "uilabel":"Package Spacing",\
+                      "uitype": "range", \
+                      "range": [0.0, 1e4], \
+                      "units":"m"}
+  double package_spacing;
+
+  #pragma cyclus var {"default": 2.5,\
+                      "tooltip":"drift radius (m)",\
+                      "doc":"radius of the drifts. Drift wall temperatures are taken this far from "\
+                            "the packages in them.",\
+                      "uilabel":"Drift Radius",\
+                      "uitype": "range", \
+                      "range": [0.0, 1e3], \
+                      "units":"m"}
+  double drift_radius;
+
+  #pragma cyclus var {"default": 2.0,\
+                      "tooltip":"host rock thermal conductivity (W/m/K)",\
+                      "doc":"thermal conductivity of the host rock",\
+                      "uilabel":"Thermal Conductivity",\
+                      "uitype": "range", \
+                      "range": [0.0, 1e3], \
+                      "units":"W/m/K"}
+  double conductivity;
+
+  #pragma cyclus var {"default": 100.0,\
+                      "tooltip":"thermal cutoff distance (m)",\
+                      "doc":"packages further than this from a point are taken not to heat it. "\
+                            "Larger cutoffs are more accurate, and the cost of emplacing a "\
+                            "package grows with the square of the cutoff.",\
+                      "uilabel":"Thermal Cutoff",\
+                      "uitype": "range", \
+                      "range": [0.0, 1e4], \
+                      "units":"m"}
+  double thermal_cutoff;
+
+  #pragma cyclus var {"default": 25.0,\
+                      "tooltip":"ambient temperature (C)",\
+                      "doc":"temperature of the host rock before any package is emplaced",\
+                      "uilabel":"Ambient Temperature",\
+                      "units":"C"}
+  double ambient_temperature;
+
+  #pragma cyclus var {"default": 200.0,\
+                      "tooltip":"drift wall temperature limit (C)",\
+                      "doc":"the highest temperature allowed on a drift wall",\
+                      "uilabel":"Drift Temperature Limit",\
+                      "units":"C"}
+  double drift_temperature_limit;
+
+  #pragma cyclus var {"default": 100.0,\
+                      "tooltip":"pillar temperature limit (C)",\
+                      "doc":"the highest temperature allowed midway between neighbouring drifts",\
+                      "uilabel":"Pillar Temperature Limit",\
+                      "units":"C"}
+  double pillar_temperature_limit;
+
+  //// the package position the next package is emplaced in
+  #pragma cyclus var {"default": 0,\
+                      "internal": True}
+  int next_slot;
+
+  //// timestep each package was emplaced in, in emplacement order
+  #pragma cyclus var {"default": [],\
+                      "internal": True}
+  std::vector<int> emplaced_times;
+
+  //// heat of each package in each heat group when it was emplaced (W),
+  //// package by package
+  #pragma cyclus var {"default": [],\
+                      "internal": True}
+  std::vector<double> emplaced_heat;
+
+  #pragma cyclus var {"tooltip":"Packages waiting to be emplaced"}
+  cyclus::toolkit::ResBuf<cyclus::Material> waiting;
+
+  #pragma cyclus var {"tooltip":"Emplaced packages"}
+  cyclus::toolkit::ResBuf<cyclus::Material> emplaced;
+
+  //// temperature rise from the packages emplaced so far
+  ThermalField field;
+
+  //// whether field has been set up
+  bool field_loaded;
+
+  //// decay heat per kg in each heat group, keyed by composition id
+  std::map<int, ThermalField::Heat> heat_cache;
+
+  //// A policy for requesting material
+  cyclus::toolkit::MatlBuyPolicy buy_policy;
+
+  #pragma cyclus var { \
+    "default": 0.0, \
+    "uilabel": "Geographical latitude in degrees as a double", \
+    "doc": "Latitude of the agent's geographical position. The value should " \
+           "be expressed in degrees as a double." \
+  }
+  double latitude;
+
+  #pragma cyclus var { \
+    "default": 0.0, \
+    "uilabel": "Geographical longitude in degrees as a double", \
+    "doc": "Longitude of the agent's geographical position. The value should " \
+           "be expressed in degrees as a double." \
+  }
+  double longitude;
+
+  cyclus::toolkit::Position coordinates;
+
+  void RecordPosition();
+
+  friend class RepositoryTest;
+};
+
+}  // namespace repository
+
+#endif  // CYDER_SRC_REPOSITORY_H_
@@ -0,0 +1,188 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "repository_tests.h"
+#include "thermal_field.h"
+
+namespace repository {
+
+namespace {
+
+const double kYear = 365.25 * 24 * 3600;
+const double kPi = 3.14159265358979323846;
+
+/// 100 W in the 30 year group
+ThermalField::Heat Package() {
+  ThermalField::Heat heat(ThermalField::kGroups, 0.0);
+  heat[2] = 100;
+  return heat;
+}
+
+/// a package of 1 kg of Cs-137
+cyclus::Material::Ptr Cs137() {
+  static cyclus::Composition::Ptr comp =
+      cyclus::Composition::CreateFromMass(cyclus::CompMap{{551370000, 1.0}});
+  return cyclus::Material::CreateUntracked(1.0, comp);
+}
+
+/// temperature rise a distance r from a source of power p in rock of
+/// conductivity 2 W/m/K
+double PointRise(double p, double r) { return p / (4 * kPi * 2.0 * r); }
+
+}  // namespace
+
+TEST(ThermalFieldTest, Groups) {
+  EXPECT_EQ(0, ThermalField::group(std::log(2.0) / (0.5 * kYear)));
+  EXPECT_EQ(2, ThermalField::group(std::log(2.0) / (30.1 * kYear)));
+  EXPECT_EQ(5, ThermalField::group(std::log(2.0) / (1e9 * kYear)));
+  for (int g = 0; g < ThermalField::kGroups; ++g) {
+    EXPECT_EQ(g, ThermalField::group(std::log(2.0) /
+                                     ThermalField::half_life(g)));
+  }
+}
+
+TEST(ThermalFieldTest, Superposition) {
+  ThermalField f;
+  f.Init(3, 5, 20, 6, 2.5, 2.0, 1000);
+  f.Add(0, Package(), 0);
+  f.Add(7, Package(), 10 * kYear);  // drift 1, position 2
+
+  double t = 20 * kYear;
+  double hl = ThermalField::half_life(2);
+  double expected =
+      PointRise(100 * std::pow(0.5, t / hl), 2.5) +
+      PointRise(100 * std::pow(0.5, 10 * kYear / hl), std::sqrt(400.0 + 144));
+  EXPECT_NEAR(expected, f.drift_temperature(0, t), 1e-9 * expected);
+
+  // the pillar between the drifts, 10 m from the first package and 12 m
+  // along and 10 m across from the second
+  expected =
+      PointRise(100 * std::pow(0.5, t / hl), 10) +
+      PointRise(100 * std::pow(0.5, 10 * kYear / hl), std::sqrt(100.0 + 144));
+  EXPECT_NEAR(expected, f.pillar_temperature(0, t), 1e-9 * expected);
+}
+
+TEST(ThermalFieldTest, Cutoff) {
+  ThermalField f;
+  f.Init(1, 100, 20, 6, 2.5, 2.0, 30);
+  f.Add(0, Package(), 0);
+  EXPECT_GT(f.drift_temperature(5, 0), 0);
+  EXPECT_EQ(0, f.drift_temperature(6, 0));
+}
+
+TEST(ThermalFieldTest, Fits) {
+  ThermalField f;
+  f.Init(1, 3, 20, 6, 2.5, 2.0, 100);
+  double self = PointRise(100, 2.5);
+  EXPECT_TRUE(f.Fits(0, Package(), 0, self * 1.001, 1e9));
+  EXPECT_FALSE(f.Fits(0, Package(), 0, self * 0.999, 1e9));
+
+  // a neighbour's heat counts against the limit until it has decayed
+  f.Add(0, Package(), 0);
+  double limit = self * 1.1;
+  EXPECT_FALSE(f.Fits(1, Package(), 0, limit, 1e9));
+  EXPECT_TRUE(f.Fits(1, Package(), 1000 * kYear, limit, 1e9));
+}
+
+TEST(ThermalFieldTest, LongTimes) {
+  // emplacing packages centuries apart must not overflow the field
+  ThermalField f;
+  f.Init(1, 50, 20, 6, 2.5, 2.0, 1000);
+  for (int i = 0; i < 50; ++i) {
+    f.Add(i, Package(), i * 100 * kYear);
+  }
+
+  double hl = ThermalField::half_life(2);
+  double expected = 0;
+  for (int i = 0; i < 50; ++i) {
+    expected += PointRise(100 * std::pow(0.5, (49 - i) * 100 * kYear / hl),
+                          std::max(2.5, (49 - i) * 6.0));
+  }
+  EXPECT_NEAR(expected, f.drift_temperature(49, 49 * 100 * kYear),
+              1e-9 * expected);
+}
+
+TEST(RepositoryTest, WaitsToCool) {
+  RepositoryTest h(1, 10, 6);
+  // only just room for a package on its own, so the second has to wait for
+  // the first to decay
+  double self = PointRise(h.PackageHeat(Cs137()), 2.5);
+  h.drift_temperature_limit(h.ambient() + 1.05 * self);
+  h.Tick();
+  h.AddMat(Cs137());
+  h.AddMat(Cs137());
+  h.Tock();
+  EXPECT_EQ(1, h.emplaced());
+  EXPECT_EQ(1, h.waiting());
+
+  while (h.waiting() > 0 && h.time() < 5000) {
+    h.Step();
+  }
+  EXPECT_EQ(2, h.emplaced());
+  // the neighbour, 6 m away, adds 2.5 / 6 of the package's own rise until
+  // it has decayed for three 30 year half-lives
+  EXPECT_GT(h.time(), 3 * 12 * 30);
+  EXPECT_LE(h.drift_temperature(1), h.ambient() + 1.05 * self + 1e-9);
+}
+
+TEST(RepositoryTest, StopsWhenFull) {
+  RepositoryTest h(1, 2, 1000);
+  h.Tick();
+  EXPECT_GT(h.room(), 0);
+  for (int i = 0; i < 3; ++i) {
+    h.AddMat(Cs137());
+  }
+  h.Tock();
+  EXPECT_EQ(2, h.emplaced());
+  EXPECT_EQ(1, h.waiting());
+
+  h.Step();
+  EXPECT_EQ(2, h.emplaced());
+  EXPECT_EQ(0, h.room());
+}
+
+TEST(RepositoryTest, EmplacementRate) {
+  RepositoryTest h(2, 5, 1000);
+  h.emplacement_rate(2);
+  h.Tick();
+  for (int i = 0; i < 5; ++i) {
+    h.AddMat(Cs137());
+  }
+  h.Tock();
+  EXPECT_EQ(2, h.emplaced());
+  h.Step();
+  EXPECT_EQ(4, h.emplaced());
+  h.Step();
+  EXPECT_EQ(5, h.emplaced());
+  EXPECT_EQ(0, h.waiting());
+}
+
+TEST(RepositoryTest, RestartKeepsField) {
+  RepositoryTest h(2, 5, 6);
+  h.emplacement_rate(1);
+  h.Tick();
+  for (int i = 0; i < 6; ++i) {
+    h.AddMat(Cs137());
+  }
+  h.Tock();
+  for (int t = 1; t < 4; ++t) {
+    h.Step();
+  }
+  ASSERT_EQ(4, h.emplaced());
+  double before[10];
+  for (int slot = 0; slot < 10; ++slot) {
+    before[slot] = h.drift_temperature(slot);
+  }
+
+  h.Restart();
+  for (int slot = 0; slot < 10; ++slot) {
+    EXPECT_NEAR(before[slot], h.drift_temperature(slot),
+                1e-9 * before[slot]);
+  }
+  h.Step();
+  EXPECT_EQ(5, h.emplaced());
+}
+
+}  // namespace repository
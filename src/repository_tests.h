@@ -0,0 +1,113 @@
+#ifndef CYDER_SRC_REPOSITORY_TESTS_H_
+#define CYDER_SRC_REPOSITORY_TESTS_H_
+
+#include "context.h"
+#include "recorder.h"
+#include "repository.h"
+#include "timer.h"
+
+namespace repository {
+
+/// @class RepositoryTest
+///
+/// Drives a Repository facility directly against a bare context, with no
+/// simulation, exchange or database behind it. Packages are handed to the
+/// facility as the buy policy would.
+///
+/// Each timestep is Tick(), any number of AddMat() calls and then Tock().
+class RepositoryTest {
+ public:
+  /// @param n_drifts the number of drifts
+  /// @param positions_per_drift the package positions in each drift
+  /// @param package_spacing the distance between positions in a drift (m)
+  RepositoryTest(int n_drifts, int positions_per_drift,
+                 double package_spacing)
+      : ctx_(&ti_, &rec_), time_(0) {
+    fac_ = new Repository(&ctx_);
+    fac_->n_drifts = n_drifts;
+    fac_->positions_per_drift = positions_per_drift;
+    fac_->drift_spacing = 20;
+    fac_->package_spacing = package_spacing;
+  }
+
+  ~RepositoryTest() { delete fac_; }
+
+  /// @brief sets the facility's emplacement_rate (packages per timestep)
+  void emplacement_rate(int n) { fac_->emplacement_rate = n; }
+
+  /// @brief sets the facility's drift wall temperature limit (C)
+  void drift_temperature_limit(double t) {
+    fac_->drift_temperature_limit = t; }
+
+  /// @brief the timestep the next Tock runs
+  int time() const { return time_; }
+
+  /// @brief the facility's ambient temperature (C)
+  double ambient() const { return fac_->ambient_temperature; }
+
+  /// @brief the quantity the facility still has room for this timestep
+  /// (kg), as set by the last Tick
+  double room() const { return fac_->waiting.space(); }
+
+  /// @brief the number of packages waiting to be emplaced
+  int waiting() const { return fac_->waiting.count(); }
+
+  /// @brief the number of packages emplaced
+  int emplaced() const { return fac_->next_slot; }
+
+  /// @brief the drift wall temperature at a package position at the start
+  /// of the next timestep (C)
+  double drift_temperature(int slot) const {
+    return fac_->ambient_temperature +
+           fac_->field.drift_temperature(slot, fac_->seconds(time_));
+  }
+
+  /// @brief the heat a package gives off when it is emplaced (W)
+  double PackageHeat(cyclus::Material::Ptr mat) {
+    return ThermalField::Power(fac_->PackageHeat_(mat), 0);
+  }
+
+  /// @brief runs Tick for the next timestep
+  void Tick() { fac_->Tick(); }
+
+  /// @brief places a package among those waiting, as the buy policy would
+  void AddMat(cyclus::Material::Ptr mat) { fac_->waiting.Push(mat); }
+
+  /// @brief runs Tock for the next timestep
+  void Tock() {
+    if (!fac_->field_loaded) {
+      fac_->LoadField_();
+    }
+    fac_->Emplace_(time_++);
+  }
+
+  /// @brief runs Tick and Tock for the next timestep
+  void Step() {
+    Tick();
+    Tock();
+  }
+
+  /// @brief replaces the facility with one built from its snapshot, as
+  /// restarting a simulation from that snapshot would
+  void Restart() {
+    fac_->Snapshot(cyclus::DbInit(fac_));
+    cyclus::Inventories invs = fac_->SnapshotInv();
+    Repository* fac = dynamic_cast<Repository*>(fac_->Clone());
+    fac->InitInv(invs);
+    delete fac_;
+    fac_ = fac;
+    // the next Tock would rebuild the field; do it now so it can be read
+    fac_->LoadField_();
+  }
+
+ private:
+  cyclus::Timer ti_;
+  cyclus::Recorder rec_;
+  cyclus::Context ctx_;
+  Repository* fac_;
+  int time_;
+};
+
+}  // namespace repository
+
+#endif  // CYDER_SRC_REPOSITORY_TESTS_H_
@@ -0,0 +1,138 @@
+#ifndef CYDER_SRC_RESIDENCE_QUEUE_H_
+#define CYDER_SRC_RESIDENCE_QUEUE_H_
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+namespace conditioning {
+
+/// @class ResidenceQueue
+///
+/// A timing wheel that tracks how many batches become ready at each
+/// timestep. Batches are grouped into one bucket per due time, so pushing
+/// and releasing cost O(1) per bucket instead of one list node per batch.
+/// The wheel grows on demand to span the earliest and latest pending due
+/// times; for a constant residence time it settles at residence_time + 1
+/// buckets.
+class ResidenceQueue {
+ public:
+  ResidenceQueue() : head_(0), base_(0), last_(0), count_(0), version_(0) {}
+
+  /// @brief schedules batches to become ready at a given time
+  /// @param due the timestep at which the batches may be released
+  /// @param n the number of batches
+  void Push(int due, int n = 1) {
+    if (n <= 0) {
+      return;
+    }
+    if (count_ == 0) {
+      if (wheel_.empty()) {
+        wheel_.assign(kMinBuckets, 0);
+      }
+      head_ = 0;
+      base_ = due;
+      last_ = due;
+    } else if (due < base_ ||
+               due - base_ >= static_cast<int>(wheel_.size())) {
+      Relayout_(std::min(due, base_), std::max(due, last_));
+    }
+    last_ = std::max(last_, due);
+    wheel_[Slot_(due)] += n;
+    count_ += n;
+    ++version_;
+  }
+
+  /// @brief removes all batches due at or before a given time
+  /// @param time the current timestep
+  /// @return the number of batches released
+  int Release(int time) {
+    int n = 0;
+    while (count_ > 0 && base_ <= time) {
+      n += wheel_[head_];
+      count_ -= wheel_[head_];
+      wheel_[head_] = 0;
+      Advance_();
+      // keep base_ on the earliest non-empty bucket
+      while (count_ > 0 && wheel_[head_] == 0) {
+        Advance_();
+      }
+    }
+    if (n > 0) {
+      ++version_;
+    }
+    return n;
+  }
+
+  /// @brief removes every pending batch
+  void Clear() {
+    std::fill(wheel_.begin(), wheel_.end(), 0);
+    head_ = 0;
+    count_ = 0;
+    ++version_;
+  }
+
+  /// @brief total number of pending batches
+  inline int count() const { return count_; }
+
+  /// @brief true if no batches are pending
+  inline bool empty() const { return count_ == 0; }
+
+  /// @brief the earliest due time of any pending batch, or -1 if empty
+  inline int next_due() const { return count_ > 0 ? base_ : -1; }
+
+  /// @brief a number that changes whenever the pending batches change
+  inline int version() const { return version_; }
+
+  /// @brief pending batches grouped by due time, in due order
+  std::map<int, int> Buckets() const {
+    std::map<int, int> buckets;
+    for (int t = base_; count_ > 0 && t <= last_; ++t) {
+      int n = wheel_[Slot_(t)];
+      if (n > 0) {
+        buckets[t] = n;
+      }
+    }
+    return buckets;
+  }
+
+ private:
+  static const int kMinBuckets = 16;
+
+  inline int Slot_(int due) const {
+    return (head_ + (due - base_)) % wheel_.size();
+  }
+
+  inline void Advance_() {
+    head_ = (head_ + 1) % wheel_.size();
+    ++base_;
+  }
+
+  /// copies pending buckets into a wheel large enough to hold [lo, hi]
+  void Relayout_(int lo, int hi) {
+    int span = hi - lo + 1;
+    int size = wheel_.size();
+    while (size < span) {
+      size *= 2;
+    }
+    std::vector<int> wheel(size, 0);
+    for (int t = base_; t <= last_; ++t) {
+      wheel[t - lo] = wheel_[Slot_(t)];
+    }
+    wheel_.swap(wheel);
+    head_ = 0;
+    base_ = lo;
+  }
+
+  /// batch counts, indexed so that wheel_[head_] holds time base_
+  std::vector<int> wheel_;
+  int head_;
+  int base_;
+  int last_;
+  int count_;
+  int version_;
+};
+
+}  // namespace conditioning
+
+#endif  // CYDER_SRC_RESIDENCE_QUEUE_H_
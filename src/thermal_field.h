@@ -0,0 +1,286 @@
+#ifndef CYDER_SRC_THERMAL_FIELD_H_
+#define CYDER_SRC_THERMAL_FIELD_H_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace repository {
+
+/// @class ThermalField
+///
+/// The temperature rise in a repository laid out as parallel drifts of
+/// equally spaced package positions. Temperatures are tracked at every
+/// package position on the drift walls and at the middle of the rock pillar
+/// between each pair of neighbouring drifts.
+///
+/// Each package is a point source whose decay heat is split into a few
+/// groups, each decaying exponentially with a fixed half-life. Heat is
+/// conducted quasi-statically, so a package of power P raises the
+/// temperature a distance r away by P / (4 pi k r). Packages further away
+/// than a cutoff are ignored, and distances are never taken as less than
+/// the drift radius.
+///
+/// Every package in a group decays at the same rate, so the field of each
+/// group is kept relative to a common reference time and scaled by its decay
+/// when it is read. Emplacing a package and checking whether one can be
+/// emplaced then only touch the positions within the cutoff of it, whatever
+/// the number of packages already emplaced, and nothing needs updating as
+/// time passes.
+class ThermalField {
+ public:
+  /// number of decay heat groups
+  static const int kGroups = 6;
+
+  /// the decay heat of a package in each group (W)
+  typedef std::vector<double> Heat;
+
+  ThermalField()
+      : drifts_(0), positions_(0), t_ref_(0) {}
+
+  /// @brief sets up the repository layout, removing any emplaced packages
+  /// @param drifts number of drifts
+  /// @param positions number of package positions along each drift
+  /// @param drift_spacing distance between drift centres (m)
+  /// @param package_spacing distance between positions along a drift (m)
+  /// @param drift_radius the least distance temperatures are taken at (m)
+  /// @param conductivity thermal conductivity of the host rock (W/m/K)
+  /// @param cutoff distance beyond which packages are ignored (m)
+  void Init(int drifts, int positions, double drift_spacing,
+            double package_spacing, double drift_radius, double conductivity,
+            double cutoff) {
+    drifts_ = drifts;
+    positions_ = positions;
+    t_ref_ = 0;
+    // pillars sit halfway between neighbouring drifts
+    drift_.Init(drifts, 0.0, positions, drift_spacing, package_spacing,
+                drift_radius, conductivity, cutoff);
+    pillar_.Init(std::max(0, drifts - 1), 0.5, positions, drift_spacing,
+                 package_spacing, drift_radius, conductivity, cutoff);
+  }
+
+  /// @brief number of package positions
+  inline int slots() const { return drifts_ * positions_; }
+
+  /// @brief the half-life of a decay heat group (s)
+  static double half_life(int group) {
+    // 0.3, 3, 30, 300, 3000 and 30000 years
+    return 0.3 * std::pow(10.0, group) * kYear;
+  }
+
+  /// @brief the decay heat group a nuclide belongs to
+  /// @param decay_const the nuclide's decay constant (1/s)
+  static int group(double decay_const) {
+    double t = std::log(2.0) / decay_const / kYear;
+    int g = 0;
+    // group edges are at 1, 10, 100, 1000 and 10000 years
+    for (double edge = 1; g < kGroups - 1 && t > edge; edge *= 10) {
+      ++g;
+    }
+    return g;
+  }
+
+  /// @brief the heat of a package some time after it was determined
+  /// @param heat the heat at the earlier time (W)
+  /// @param dt the time elapsed (s)
+  /// @return the total heat (W)
+  static double Power(const Heat& heat, double dt) {
+    double p = 0;
+    for (int g = 0; g < kGroups; ++g) {
+      p += heat[g] * std::exp(-lambda(g) * dt);
+    }
+    return p;
+  }
+
+  /// @brief the temperature rise at a package position on the drift wall
+  /// @param slot the package position, drift by drift
+  /// @param t the current time (s)
+  inline double drift_temperature(int slot, double t) const {
+    double decay[kGroups];
+    Decay_(t, decay);
+    return drift_.Rise(slot, decay);
+  }
+
+  /// @brief the highest temperature rise in the pillars next to a package
+  /// position
+  /// @param slot the package position, drift by drift
+  /// @param t the current time (s)
+  double pillar_temperature(int slot, double t) const {
+    double decay[kGroups];
+    Decay_(t, decay);
+    int d = slot / positions_;
+    int x = slot % positions_;
+    double rise = 0;
+    if (d > 0) {
+      rise = pillar_.Rise((d - 1) * positions_ + x, decay);
+    }
+    if (d < drifts_ - 1) {
+      rise = std::max(rise, pillar_.Rise(d * positions_ + x, decay));
+    }
+    return rise;
+  }
+
+  /// @brief checks that emplacing a package would keep temperatures within
+  /// their limits. Temperatures only fall as packages decay, so limits that
+  /// hold when the package is emplaced hold from then on.
+  /// @param slot the package position, drift by drift
+  /// @param heat the package's heat at time t (W)
+  /// @param t the current time (s)
+  /// @param drift_limit the largest allowed rise on the drift walls (K)
+  /// @param pillar_limit the largest allowed rise in the pillars (K)
+  bool Fits(int slot, const Heat& heat, double t, double drift_limit,
+            double pillar_limit) const {
+    double decay[kGroups];
+    Decay_(t, decay);
+    double p = Power(heat, 0);
+    return drift_.Fits(slot / positions_, slot % positions_, p, decay,
+                       drift_limit) &&
+           pillar_.Fits(slot / positions_, slot % positions_, p, decay,
+                        pillar_limit);
+  }
+
+  /// @brief emplaces a package
+  /// @param slot the package position, drift by drift
+  /// @param heat the package's heat at time t (W)
+  /// @param t the current time (s)
+  void Add(int slot, const Heat& heat, double t) {
+    // rebase before the stored fields could overflow
+    if (lambda(0) * (t - t_ref_) > kMaxExponent) {
+      double decay[kGroups];
+      Decay_(t, decay);
+      drift_.Scale(decay);
+      pillar_.Scale(decay);
+      t_ref_ = t;
+    }
+
+    // the heat each group would have had at the reference time
+    double ref[kGroups];
+    for (int g = 0; g < kGroups; ++g) {
+      ref[g] = heat[g] * std::exp(lambda(g) * (t - t_ref_));
+    }
+    drift_.Add(slot / positions_, slot % positions_, ref);
+    pillar_.Add(slot / positions_, slot % positions_, ref);
+  }
+
+ private:
+  static constexpr double kYear = 365.25 * 24 * 3600;
+  static constexpr double kPi = 3.14159265358979323846;
+
+  /// the largest growth factor exponent the stored fields may reach
+  static constexpr double kMaxExponent = 200;
+
+  static inline double lambda(int group) {
+    return std::log(2.0) / half_life(group);
+  }
+
+  /// the decay of each group from the reference time to t
+  void Decay_(double t, double* decay) const {
+    for (int g = 0; g < kGroups; ++g) {
+      decay[g] = std::exp(-lambda(g) * (t - t_ref_));
+    }
+  }
+
+  /// One row of temperature points per drift or pillar, with the response
+  /// of each point to a unit source at every package position within the
+  /// cutoff, stored as offsets from the source.
+  class Grid {
+   public:
+    Grid() : rows_(0), cols_(0) {}
+
+    void Init(int rows, double offset, int cols, double drift_spacing,
+              double package_spacing, double radius, double conductivity,
+              double cutoff) {
+      rows_ = rows;
+      cols_ = cols;
+      kernel_.clear();
+      int max_dx = static_cast<int>(cutoff / package_spacing);
+      int max_dy = static_cast<int>(cutoff / drift_spacing + 1);
+      for (int dy = -max_dy; dy <= max_dy; ++dy) {
+        double y = (dy + offset) * drift_spacing;
+        for (int dx = -max_dx; dx <= max_dx; ++dx) {
+          double x = dx * package_spacing;
+          double r = std::sqrt(x * x + y * y);
+          if (r <= cutoff) {
+            Response k = {dy, dx,
+                          1 / (4 * kPi * conductivity * std::max(r, radius))};
+            kernel_.push_back(k);
+          }
+        }
+      }
+      field_.assign(rows_ * cols_ * kGroups, 0.0);
+    }
+
+    /// the temperature rise at a point
+    inline double Rise(int point, const double* decay) const {
+      const double* f = &field_[point * kGroups];
+      double rise = 0;
+      for (int g = 0; g < kGroups; ++g) {
+        rise += f[g] * decay[g];
+      }
+      return rise;
+    }
+
+    /// true if no point near a source at (row, col) of power p would rise
+    /// past the limit
+    bool Fits(int row, int col, double p, const double* decay,
+              double limit) const {
+      for (int i = 0; i < static_cast<int>(kernel_.size()); ++i) {
+        int y = row + kernel_[i].dy;
+        int x = col + kernel_[i].dx;
+        if (y >= 0 && y < rows_ && x >= 0 && x < cols_ &&
+            Rise(y * cols_ + x, decay) + p * kernel_[i].k > limit) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    /// adds a source at (row, col) with heat given at the reference time
+    void Add(int row, int col, const double* heat) {
+      for (int i = 0; i < static_cast<int>(kernel_.size()); ++i) {
+        int y = row + kernel_[i].dy;
+        int x = col + kernel_[i].dx;
+        if (y >= 0 && y < rows_ && x >= 0 && x < cols_) {
+          double* f = &field_[(y * cols_ + x) * kGroups];
+          for (int g = 0; g < kGroups; ++g) {
+            f[g] += heat[g] * kernel_[i].k;
+          }
+        }
+      }
+    }
+
+    /// multiplies each group of the field by a factor
+    void Scale(const double* factor) {
+      for (int i = 0; i < static_cast<int>(field_.size()); ++i) {
+        field_[i] *= factor[i % kGroups];
+      }
+    }
+
+   private:
+    struct Response {
+      int dy;
+      int dx;
+      double k;
+    };
+
+    int rows_;
+    int cols_;
+    std::vector<Response> kernel_;
+
+    /// temperature rise per group at the reference time, point by point
+    std::vector<double> field_;
+  };
+
+  int drifts_;
+  int positions_;
+
+  /// the time the stored fields are relative to (s)
+  double t_ref_;
+
+  Grid drift_;
+  Grid pillar_;
+};
+
+}  // namespace repository
+
+#endif  // CYDER_SRC_THERMAL_FIELD_H_
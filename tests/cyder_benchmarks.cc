@@ -0,0 +1,191 @@
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "conditioning_tests.h"
+#include "logger.h"
+
+namespace {
+
+/// the number of heap allocations made so far
+long& AllocCount() {
+  static long n = 0;
+  return n;
+}
+
+}  // namespace
+
+// Every heap allocation in the process goes through here so that benchmarks
+// can report allocations per tock, including those made inside cyclus.
+void* operator new(std::size_t size) {
+  ++AllocCount();
+  void* p = std::malloc(size == 0 ? 1 : size);
+  if (p == NULL) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+namespace {
+
+// Lets a CYDER_PROFILE build count allocations in each phase too.
+const bool kAllocCounterSet = (conditioning::AllocCounter() = [] {
+  return AllocCount();
+}, true);
+
+}  // namespace
+
+namespace {
+
+using conditioning::ConditioningTest;
+
+/// batch size distributions
+enum { kFixed = 0, kLogNormal = 1 };
+
+std::vector<double> BatchSizes(int n, int dist, std::mt19937* gen) {
+  std::vector<double> sizes(n, 1.0);
+  if (dist == kLogNormal) {
+    std::lognormal_distribution<double> d(0.0, 1.0);
+    for (int i = 0; i < n; ++i) {
+      sizes[i] = d(*gen);
+    }
+  }
+  return sizes;
+}
+
+/// mean batch size of a distribution (kg)
+double MeanBatchSize(int dist) {
+  return dist == kLogNormal ? std::exp(0.5) : 1.0;
+}
+
+/// the process's resident set size now, 0 where it cannot be read (kB).
+/// Unlike the peak, this can fall, so the difference across one benchmark
+/// is what that benchmark has left resident.
+long RssKb() {
+  std::FILE* f = std::fopen("/proc/self/statm", "r");
+  if (f == NULL) {
+    return 0;
+  }
+  long size = 0;
+  long resident = 0;
+  int n = std::fscanf(f, "%ld %ld", &size, &resident);
+  std::fclose(f);
+  return n == 2 ? resident * (sysconf(_SC_PAGESIZE) / 1024) : 0;
+}
+
+// Args: batches per tock, batch size distribution, residence time (steps),
+// throughput (kg per step, 0 for unlimited), discrete handling (0 or 1).
+void BM_ConditioningTock(benchmark::State& state) {
+  int batches = state.range(0);
+  int dist = state.range(1);
+  int residence = state.range(2);
+  double throughput = state.range(3) > 0 ? state.range(3) : 1e299;
+  bool discrete = state.range(4) != 0;
+
+  long rss = RssKb();
+  cyclus::Composition::Ptr comp =
+      cyclus::Composition::CreateFromMass(cyclus::CompMap{{551370000, 1.0}});
+  std::mt19937 gen(1);
+  ConditioningTest h(residence, throughput, discrete);
+  h.check_invariants(false);
+
+  // fill the residence pipeline so every measured tock is in steady state
+  for (int t = 0; t <= residence; ++t) {
+    std::vector<double> sizes = BatchSizes(batches, dist, &gen);
+    h.Tick();
+    for (int i = 0; i < batches; ++i) {
+      h.AddMat(cyclus::Material::CreateUntracked(sizes[i], comp));
+    }
+    h.Tock();
+    h.Drain();
+  }
+
+  long allocs = 0;
+  for (auto _ : state) {
+    std::vector<double> sizes = BatchSizes(batches, dist, &gen);
+
+    long before = AllocCount();
+    auto start = std::chrono::steady_clock::now();
+    h.Tick();
+    auto end = std::chrono::steady_clock::now();
+    allocs += AllocCount() - before;
+    std::chrono::duration<double> elapsed = end - start;
+
+    for (int i = 0; i < batches; ++i) {
+      h.AddMat(cyclus::Material::CreateUntracked(sizes[i], comp));
+    }
+
+    before = AllocCount();
+    start = std::chrono::steady_clock::now();
+    h.Tock();
+    end = std::chrono::steady_clock::now();
+    allocs += AllocCount() - before;
+    elapsed += end - start;
+
+    state.SetIterationTime(elapsed.count());
+    h.Drain();
+  }
+
+  state.SetItemsProcessed(state.iterations() * batches);
+  state.counters["allocs_per_tock"] =
+      benchmark::Counter(allocs, benchmark::Counter::kAvgIterations);
+  state.counters["rss_growth_kb"] = RssKb() - rss;
+}
+
+void ConditioningArgs(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"batches", "dist", "residence", "throughput", "discrete"});
+  const int batches[] = {10, 1000, 10000};
+  const int residences[] = {0, 12, 120};
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      for (int dist = kFixed; dist <= kLogNormal; ++dist) {
+        for (int discrete = 0; discrete <= 1; ++discrete) {
+          // unlimited, and throttled to half the mean arrival rate
+          int half = batches[i] * MeanBatchSize(dist) / 2;
+          b->Args({batches[i], dist, residences[j], 0, discrete});
+          b->Args({batches[i], dist, residences[j], half, discrete});
+        }
+      }
+    }
+  }
+}
+
+BENCHMARK(BM_ConditioningTock)->Apply(ConditioningArgs)->UseManualTime();
+
+// Args: batches scheduled per step, residence time (steps).
+void BM_ResidenceQueue(benchmark::State& state) {
+  int batches = state.range(0);
+  int residence = state.range(1);
+  conditioning::ResidenceQueue q;
+  int t = 0;
+  for (auto _ : state) {
+    q.Push(t + residence, batches);
+    benchmark::DoNotOptimize(q.Release(t));
+    ++t;
+  }
+}
+
+BENCHMARK(BM_ResidenceQueue)
+    ->ArgNames({"batches", "residence"})
+    ->Args({1, 12})
+    ->Args({10000, 12})
+    ->Args({10000, 12000});
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  cyclus::Logger::ReportLevel() = cyclus::LEV_ERROR;
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,165 @@
+#!/usr/bin/env python
+"""Generates scaled Source -> Reactor -> Conditioning -> Sink scenarios for
+the performance harness (see run_perf.py).
+
+Every reactor discharges one batch of ``batch_size`` kg of spent fuel each
+step, which is shared by the conditioning facilities and sent on to a single
+sink with unlimited capacity.
+"""
+from __future__ import print_function
+
+import argparse
+
+HEADER = """<simulation>
+  <archetypes>
+    <spec><lib>agents</lib><name>NullRegion</name></spec>
+    <spec><lib>agents</lib><name>NullInst</name></spec>
+    <spec><lib>cycamore</lib><name>Source</name></spec>
+    <spec><lib>cycamore</lib><name>Reactor</name></spec>
+    <spec><lib>cycamore</lib><name>Sink</name></spec>
+    <spec><lib>cyder</lib><name>Conditioning</name></spec>
+  </archetypes>
+
+  <control>
+    <duration>{duration}</duration>
+    <startmonth>1</startmonth>
+    <startyear>2000</startyear>
+  </control>
+"""
+
+FACILITIES = """
+  <facility>
+    <name>source</name>
+    <config>
+      <Source>
+        <outcommod>fuel</outcommod>
+        <outrecipe>fresh_uox</outrecipe>
+        <throughput>1e299</throughput>
+      </Source>
+    </config>
+  </facility>
+
+  <facility>
+    <name>reactor</name>
+    <config>
+      <Reactor>
+        <assem_size>{batch_size}</assem_size>
+        <cycle_time>1</cycle_time>
+        <refuel_time>0</refuel_time>
+        <n_assem_batch>1</n_assem_batch>
+        <n_assem_core>1</n_assem_core>
+        <power_cap>1</power_cap>
+        <fuel_incommods><val>fuel</val></fuel_incommods>
+        <fuel_inrecipes><val>fresh_uox</val></fuel_inrecipes>
+        <fuel_outcommods><val>spent_uox</val></fuel_outcommods>
+        <fuel_outrecipes><val>spent_uox</val></fuel_outrecipes>
+      </Reactor>
+    </config>
+  </facility>
+
+  <facility>
+    <name>conditioning_fac</name>
+    <config>
+      <Conditioning>
+        <in_commods><val>spent_uox</val></in_commods>
+        <out_commods><val>packaged_spent_uox</val></out_commods>
+        <residence_time>{residence_time}</residence_time>
+        <throughput>{throughput}</throughput>
+        <max_inv_size>1e299</max_inv_size>
+        <discrete_handling>{discrete}</discrete_handling>
+      </Conditioning>
+    </config>
+  </facility>
+
+  <facility>
+    <name>sink</name>
+    <config>
+      <Sink>
+        <in_commods><val>packaged_spent_uox</val></in_commods>
+        <max_inv_size>1e299</max_inv_size>
+      </Sink>
+    </config>
+  </facility>
+"""
+
+FOOTER = """
+  <recipe>
+    <name>fresh_uox</name>
+    <basis>mass</basis>
+    <nuclide><id>U235</id><comp>0.711</comp></nuclide>
+    <nuclide><id>U238</id><comp>99.289</comp></nuclide>
+  </recipe>
+
+  <recipe>
+    <name>spent_uox</name>
+    <basis>mass</basis>
+    <nuclide><id>Kr85</id><comp>50</comp></nuclide>
+    <nuclide><id>Cs137</id><comp>50</comp></nuclide>
+  </recipe>
+
+  <region>
+    <name>region</name>
+    <config><NullRegion/></config>
+    <institution>
+      <name>nullinst</name>
+      <config><NullInst/></config>
+      <initialfacilitylist>
+        <entry><prototype>source</prototype><number>1</number></entry>
+        <entry><prototype>reactor</prototype><number>{reactors}</number></entry>
+        <entry><prototype>conditioning_fac</prototype><number>{conditioning}</number></entry>
+        <entry><prototype>sink</prototype><number>1</number></entry>
+      </initialfacilitylist>
+    </institution>
+  </region>
+</simulation>
+"""
+
+
+def scenario(reactors=1, conditioning=1, duration=120, batch_size=1.0,
+             residence_time=1, throughput=1e299, discrete=False):
+    """Returns the input file for a scenario as a string.
+
+    Parameters
+    ----------
+    reactors : int
+        Number of reactors, each discharging one batch per step.
+    conditioning : int
+        Number of conditioning facilities.
+    duration : int
+        Simulation duration in steps.
+    batch_size : float
+        Mass of each discharged batch (kg).
+    residence_time : int
+        Conditioning residence time in steps.
+    throughput : float
+        Throughput of each conditioning facility (kg per step).
+    discrete : bool
+        Whether the conditioning facilities handle batches discretely.
+    """
+    params = dict(reactors=reactors, conditioning=conditioning,
+                  duration=duration, batch_size=batch_size,
+                  residence_time=residence_time, throughput=throughput,
+                  discrete=int(bool(discrete)))
+    return (HEADER.format(**params) + FACILITIES.format(**params) +
+            FOOTER.format(**params))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('output', help='input file to write')
+    parser.add_argument('--reactors', type=int, default=1)
+    parser.add_argument('--conditioning', type=int, default=1)
+    parser.add_argument('--duration', type=int, default=120)
+    parser.add_argument('--batch-size', type=float, default=1.0)
+    parser.add_argument('--residence-time', type=int, default=1)
+    parser.add_argument('--throughput', type=float, default=1e299)
+    parser.add_argument('--discrete', action='store_true')
+    args = parser.parse_args()
+    with open(args.output, 'w') as f:
+        f.write(scenario(args.reactors, args.conditioning, args.duration,
+                         args.batch_size, args.residence_time,
+                         args.throughput, args.discrete))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,126 @@
+#!/usr/bin/env python
+"""Runs the performance scale points in scales.json and compares wall time,
+peak memory and output database size against a stored baseline.
+
+Each scale point is generated with generate_scenario.py and run through
+cyclus once. Results more than ``--tolerance`` above the baseline are
+reported as regressions and make the script exit with a non-zero status.
+Use ``--save-baseline`` on a reference build to record a new baseline.
+"""
+from __future__ import print_function
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+from generate_scenario import scenario
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+METRICS = ('wall_s', 'peak_rss_kb', 'db_kb')
+
+
+def run_point(cyclus, params, workdir, name):
+    """Runs one scale point and returns its metrics."""
+    infile = os.path.join(workdir, name + '.xml')
+    outfile = os.path.join(workdir, name + '.sqlite')
+    with open(infile, 'w') as f:
+        f.write(scenario(**params))
+
+    with open(os.devnull, 'w') as devnull:
+        start = time.time()
+        proc = subprocess.Popen([cyclus, '-o', outfile, infile],
+                                stdout=devnull, stderr=devnull)
+        # wait4 gives the resource usage of this run alone
+        _, status, usage = os.wait4(proc.pid, 0)
+        wall = time.time() - start
+    if status != 0:
+        raise RuntimeError('cyclus failed on scale point ' + name)
+
+    return {'wall_s': round(wall, 3),
+            'peak_rss_kb': usage.ru_maxrss,
+            'db_kb': os.path.getsize(outfile) // 1024}
+
+
+def compare(results, baseline, tolerance):
+    """Prints results against the baseline and returns the regressions."""
+    regressions = []
+    row = '{0:<16} {1:<12} {2:>14} {3:>14} {4:>8}'
+    print(row.format('scale', 'metric', 'baseline', 'result', 'change'))
+    for name in sorted(results):
+        for metric in METRICS:
+            value = results[name][metric]
+            base = baseline.get(name, {}).get(metric)
+            if base is None or base == 0:
+                print(row.format(name, metric, '-', value, '-'))
+                continue
+            change = (value - base) / float(base)
+            print(row.format(name, metric, base, value,
+                             '{0:+.1%}'.format(change)))
+            if change > tolerance:
+                regressions.append((name, metric))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--cyclus', default='cyclus',
+                        help='cyclus executable to run')
+    parser.add_argument('--scales', default=os.path.join(HERE, 'scales.json'),
+                        help='scale point definitions')
+    parser.add_argument('--baseline',
+                        default=os.path.join(HERE, 'baseline.json'),
+                        help='baseline results to compare against')
+    parser.add_argument('--only', nargs='*',
+                        help='scale points to run, all by default')
+    parser.add_argument('--tolerance', type=float, default=0.25,
+                        help='allowed fractional increase over the baseline')
+    parser.add_argument('--save-baseline', action='store_true',
+                        help='write the results as the new baseline')
+    parser.add_argument('--keep', action='store_true',
+                        help='keep the generated inputs and databases')
+    args = parser.parse_args()
+
+    with open(args.scales) as f:
+        scales = json.load(f)
+    names = args.only or sorted(scales)
+
+    workdir = tempfile.mkdtemp(prefix='cyder_perf_')
+    results = {}
+    try:
+        for name in names:
+            print('running ' + name, file=sys.stderr)
+            results[name] = run_point(args.cyclus, scales[name], workdir,
+                                      name)
+    finally:
+        if args.keep:
+            print('outputs kept in ' + workdir, file=sys.stderr)
+        else:
+            shutil.rmtree(workdir)
+
+    if args.save_baseline:
+        with open(args.baseline, 'w') as f:
+            json.dump(results, f, indent=4, sort_keys=True)
+        print('baseline written to ' + args.baseline)
+        return 0
+
+    baseline = {}
+    if os.path.exists(args.baseline):
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+    else:
+        print('no baseline at {0}, nothing to compare against'.format(
+            args.baseline), file=sys.stderr)
+
+    regressions = compare(results, baseline, args.tolerance)
+    for name, metric in regressions:
+        print('REGRESSION: {0} {1}'.format(name, metric))
+    return 1 if regressions else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
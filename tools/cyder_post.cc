@@ -0,0 +1,305 @@
+// cyder_post.cc
+// Answers standard queries on the cyder facilities in a cyclus SQLite output
+// database from a columnar, memory-mapped cache of it.
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "post_cache.h"
+
+namespace cyder_post {
+
+static const char* kUsage =
+    "usage: cyder_post [options] DB QUERY\n"
+    "\n"
+    "Queries, each written as CSV to standard output:\n"
+    "  throughput  kg received and shipped by each facility per timestep\n"
+    "  packages    packages received, shipped and held per timestep\n"
+    "  occupancy   kg held by each facility per timestep\n"
+    "  residence   kg shipped by each facility by timesteps held, matching\n"
+    "              shipments to receipts first in, first out\n"
+    "  stages      kg held in each Conditioning buffer per reporting period,\n"
+    "              from the ConditioningFlows table\n"
+    "\n"
+    "Options:\n"
+    "  --simid ID   simulation to report, as hex(SimId) or its UUID; needed\n"
+    "               if DB holds more than one\n"
+    "  --agent ID   only report facility ID\n"
+    "  --threads N  aggregate on N threads (default: all cores)\n"
+    "  --cache PATH cache file (default: DB.cyder_post, or one in $TMPDIR\n"
+    "               or /tmp if the database's directory is not writable)\n"
+    "  --rebuild    rebuild the cache even if it is up to date\n";
+
+/// quantities below this are taken as zero (kg), as cyclus::eps_rsrc()
+static const double kEps = 1e-6;
+
+/// Writes one facility's rows of a query.
+typedef void (*Query)(const ColumnCache& cache, int agent, std::ostream& out);
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+static void Throughput(const ColumnCache& cache, int i, std::ostream& out) {
+  const Agent& a = cache.agent(i);
+  for (int64_t r = cache.begin(i); r < cache.begin(i + 1);) {
+    int t = cache.time()[r];
+    double in = 0;
+    double shipped = 0;
+    for (; r < cache.begin(i + 1) && cache.time()[r] == t; ++r) {
+      (cache.dir()[r] > 0 ? in : shipped) += cache.qty()[r];
+    }
+    out << a.id << "," << a.prototype << "," << t << "," << in << ","
+        << shipped << "\n";
+  }
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+static void Packages(const ColumnCache& cache, int i, std::ostream& out) {
+  const Agent& a = cache.agent(i);
+  long held = 0;
+  for (int64_t r = cache.begin(i); r < cache.begin(i + 1);) {
+    int t = cache.time()[r];
+    long in = 0;
+    long shipped = 0;
+    for (; r < cache.begin(i + 1) && cache.time()[r] == t; ++r) {
+      ++(cache.dir()[r] > 0 ? in : shipped);
+    }
+    held += in - shipped;
+    out << a.id << "," << a.prototype << "," << t << "," << in << ","
+        << shipped << "," << held << "\n";
+  }
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+static void Occupancy(const ColumnCache& cache, int i, std::ostream& out) {
+  const Agent& a = cache.agent(i);
+  if (cache.begin(i) == cache.begin(i + 1)) {
+    return;
+  }
+  // every timestep from the first transaction to the last, including those
+  // without any
+  double held = 0;
+  int64_t r = cache.begin(i);
+  int last = cache.time()[cache.begin(i + 1) - 1];
+  for (int t = cache.time()[r]; t <= last; ++t) {
+    for (; r < cache.begin(i + 1) && cache.time()[r] == t; ++r) {
+      held += cache.dir()[r] * cache.qty()[r];
+    }
+    out << a.id << "," << a.prototype << "," << t << "," << held << "\n";
+  }
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+static void Residence(const ColumnCache& cache, int i, std::ostream& out) {
+  const Agent& a = cache.agent(i);
+  // receipts not yet matched to a shipment, as (time, kg), oldest first
+  std::deque<std::pair<int, double> > held;
+  std::map<int, double> hist;
+  for (int64_t r = cache.begin(i); r < cache.begin(i + 1);) {
+    int t = cache.time()[r];
+    int64_t end = r;
+    while (end < cache.begin(i + 1) && cache.time()[end] == t) {
+      ++end;
+    }
+    // material received in a timestep can only ship in a later one, so
+    // match the timestep's shipments before adding its receipts
+    for (int64_t s = r; s < end; ++s) {
+      double qty = cache.qty()[s];
+      while (cache.dir()[s] < 0 && qty > kEps && !held.empty()) {
+        double k = std::min(qty, held.front().second);
+        hist[t - held.front().first] += k;
+        qty -= k;
+        held.front().second -= k;
+        if (held.front().second <= kEps) {
+          held.pop_front();
+        }
+      }
+    }
+    for (; r < end; ++r) {
+      if (cache.dir()[r] > 0) {
+        held.push_back(std::make_pair(t, cache.qty()[r]));
+      }
+    }
+  }
+  std::map<int, double>::const_iterator it;
+  for (it = hist.begin(); it != hist.end(); ++it) {
+    out << a.id << "," << a.prototype << "," << it->first << ","
+        << it->second << "\n";
+  }
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+static void StageOccupancy(const ColumnCache& cache, int i,
+                           std::ostream& out) {
+  const Agent& a = cache.agent(i);
+  const Stages* begin = cache.stages();
+  const Stages* end = begin + cache.n_stages();
+  // rows are sorted by agent id
+  int lo = 0;
+  int hi = cache.n_stages();
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (begin[mid].agent < a.id) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  for (const Stages* s = begin + lo; s != end && s->agent == a.id; ++s) {
+    out << a.id << "," << a.prototype << "," << s->time;
+    for (int k = 0; k < 5; ++k) {
+      out << "," << s->held[k];
+    }
+    out << "\n";
+  }
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+/// Runs a query for each facility across a pool of threads and writes the
+/// results in facility order. Facilities are handed out one at a time, so a
+/// few busy facilities do not hold up the rest.
+static void Run(const ColumnCache& cache, Query query,
+                const std::vector<int>& agents, int n_threads) {
+  std::vector<std::string> results(agents.size());
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> pool;
+  for (int n = 0; n < n_threads; ++n) {
+    pool.push_back(std::thread([&]() {
+      for (size_t k = next++; k < agents.size(); k = next++) {
+        std::ostringstream out;
+        out.precision(17);
+        query(cache, agents[k], out);
+        results[k] = out.str();
+      }
+    }));
+  }
+  for (int n = 0; n < n_threads; ++n) {
+    pool[n].join();
+  }
+  for (size_t k = 0; k < results.size(); ++k) {
+    std::fwrite(results[k].data(), 1, results[k].size(), stdout);
+  }
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+/// The cache file for a database: DB.cyder_post next to it if its directory
+/// can be written, otherwise a file in the temporary directory named for the
+/// database's full path, so that databases in read-only places still get a
+/// cache of their own.
+static std::string DefaultCachePath(const std::string& db) {
+  std::string dir = ".";
+  size_t slash = db.rfind('/');
+  if (slash != std::string::npos) {
+    dir = db.substr(0, std::max<size_t>(slash, 1));
+  }
+  if (access(dir.c_str(), W_OK) == 0) {
+    return db + ".cyder_post";
+  }
+
+  char* full = realpath(db.c_str(), NULL);
+  std::string key = full == NULL ? db : full;
+  std::free(full);
+  const char* tmp = std::getenv("TMPDIR");
+  std::ostringstream path;
+  path << (tmp != NULL && *tmp != '\0' ? tmp : "/tmp") << "/"
+       << db.substr(slash == std::string::npos ? 0 : slash + 1) << "."
+       << std::hex << std::hash<std::string>()(key) << ".cyder_post";
+  return path.str();
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+static int Main(int argc, char** argv) {
+  std::string db;
+  std::string name;
+  std::string path;
+  std::string simid;
+  int agent = -1;
+  int n_threads = std::thread::hardware_concurrency();
+  bool rebuild = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--simid" && i + 1 < argc) {
+      simid = argv[++i];
+    } else if (arg == "--agent" && i + 1 < argc) {
+      agent = std::atoi(argv[++i]);
+    } else if (arg == "--threads" && i + 1 < argc) {
+      n_threads = std::atoi(argv[++i]);
+    } else if (arg == "--cache" && i + 1 < argc) {
+      path = argv[++i];
+    } else if (arg == "--rebuild") {
+      rebuild = true;
+    } else if (arg == "-h" || arg == "--help") {
+      std::cout << kUsage;
+      return 0;
+    } else if (db.empty()) {
+      db = arg;
+    } else if (name.empty()) {
+      name = arg;
+    } else {
+      std::cerr << kUsage;
+      return 2;
+    }
+  }
+
+  Query query;
+  const char* header;
+  if (name == "throughput") {
+    query = Throughput;
+    header = "AgentId,Prototype,Time,Received,Shipped";
+  } else if (name == "packages") {
+    query = Packages;
+    header = "AgentId,Prototype,Time,Received,Shipped,Held";
+  } else if (name == "occupancy") {
+    query = Occupancy;
+    header = "AgentId,Prototype,Time,Held";
+  } else if (name == "residence") {
+    query = Residence;
+    header = "AgentId,Prototype,ResidenceTime,Quantity";
+  } else if (name == "stages") {
+    query = StageOccupancy;
+    header =
+        "AgentId,Prototype,EndTime,InventoryHeld,ProcessingHeld,"
+        "PackagedHeld,ReadyHeld,StocksHeld";
+  } else {
+    std::cerr << kUsage;
+    return 2;
+  }
+  if (path.empty()) {
+    path = DefaultCachePath(db);
+  }
+
+  ColumnCache cache;
+  cache.Open(db, path, simid, rebuild);
+
+  std::vector<int> agents;
+  for (int i = 0; i < cache.n_agents(); ++i) {
+    if (agent < 0 || cache.agent(i).id == agent) {
+      agents.push_back(i);
+    }
+  }
+  std::cout << header << std::endl;
+  Run(cache, query, agents, std::max(1, n_threads));
+  return 0;
+}
+
+}  // namespace cyder_post
+
+int main(int argc, char** argv) {
+  try {
+    return cyder_post::Main(argc, argv);
+  } catch (std::exception& e) {
+    std::cerr << "cyder_post: " << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,441 @@
+#ifndef CYDER_TOOLS_POST_CACHE_H_
+#define CYDER_TOOLS_POST_CACHE_H_
+
+#include <fcntl.h>
+#include <sqlite3.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace cyder_post {
+
+/// A cyder facility in the output database.
+struct Agent {
+  int32_t id;
+  int32_t enter_time;
+  char prototype[56];
+};
+
+/// One row of a cyder facility's ConditioningFlows table: the quantity held
+/// in the inventory, processing, packaged, ready and stocks buffers at the
+/// end of a reporting period.
+struct Stages {
+  int32_t agent;
+  int32_t time;
+  double held[5];
+};
+
+/// @class ColumnCache
+///
+/// The transactions into and out of cyder facilities in one simulation, as
+/// columns sorted by agent and time, in a file that is memory mapped when it
+/// is read. Building the cache streams the Transactions and Resources tables
+/// once; after that, queries read only the columns they
+/// need and never touch the database. The cache is rebuilt whenever the
+/// database changes size or modification time, or another simulation in it
+/// is asked for.
+class ColumnCache {
+ public:
+  ColumnCache() : data_(NULL), size_(0) {}
+  ~ColumnCache() { Unmap_(); }
+
+  /// @brief opens the cache for a simulation in a database, building it
+  /// first if it is missing, stale, for another simulation or a rebuild is
+  /// asked for
+  /// @param db path to the SQLite output database
+  /// @param path path to the cache file
+  /// @param simid the simulation, as hex(SimId) with or without the dashes
+  /// of a UUID, or empty if the database only holds one
+  /// @param rebuild whether to rebuild the cache regardless
+  void Open(const std::string& db, const std::string& path,
+            const std::string& simid, bool rebuild) {
+    struct stat st;
+    if (stat(db.c_str(), &st) != 0) {
+      throw std::runtime_error("cannot read " + db);
+    }
+    std::string sim = FindSimId(db, simid);
+    if (rebuild || !Map_(path, st, sim)) {
+      Build(db, path, st, sim);
+      if (!Map_(path, st, sim)) {
+        throw std::runtime_error("cannot read cache " + path);
+      }
+    }
+  }
+
+  /// @brief number of cyder facilities
+  int n_agents() const { return header_->n_agents; }
+
+  /// @brief a cyder facility
+  const Agent& agent(int i) const { return agents_[i]; }
+
+  /// @brief the transaction rows of facility i are [begin(i), begin(i + 1))
+  int64_t begin(int i) const { return begins_[i]; }
+
+  /// @brief time of each transaction
+  const int32_t* time() const { return time_; }
+
+  /// @brief +1 for transactions into the facility, -1 for those out of it
+  const int8_t* dir() const { return dir_; }
+
+  /// @brief quantity of each transaction (kg)
+  const double* qty() const { return qty_; }
+
+  /// @brief number of ConditioningFlows rows
+  int64_t n_stages() const { return header_->n_stages; }
+
+  /// @brief ConditioningFlows rows, sorted by agent and time
+  const Stages* stages() const { return stages_; }
+
+  /// @brief finds a simulation in a database
+  /// @param db path to the SQLite output database
+  /// @param simid the simulation asked for, as for Open, or empty for the
+  /// only one
+  /// @return the simulation's hex(SimId)
+  static std::string FindSimId(const std::string& db,
+                               const std::string& simid) {
+    std::string wanted;
+    for (size_t i = 0; i < simid.size(); ++i) {
+      if (simid[i] != '-') {
+        wanted += std::toupper(static_cast<unsigned char>(simid[i]));
+      }
+    }
+
+    sqlite3* conn = Connect_(db);
+    std::vector<std::string> sims;
+    Statement q(conn, "SELECT DISTINCT hex(SimId) FROM AgentEntry");
+    while (q.Step()) {
+      sims.push_back(q.Text(0));
+    }
+    q.Finalize();
+    sqlite3_close(conn);
+
+    if (!wanted.empty()) {
+      if (std::find(sims.begin(), sims.end(), wanted) == sims.end()) {
+        throw std::runtime_error("no simulation " + simid + " in " + db);
+      }
+      return wanted;
+    }
+    if (sims.empty()) {
+      throw std::runtime_error("no simulation in " + db);
+    }
+    if (sims.size() > 1) {
+      std::string msg = db + " holds several simulations; pick one with "
+                             "--simid:";
+      for (size_t i = 0; i < sims.size(); ++i) {
+        msg += " " + sims[i];
+      }
+      throw std::runtime_error(msg);
+    }
+    return sims[0];
+  }
+
+  /// @brief streams one simulation in the database into a new cache file.
+  /// SQLite sorts the transactions, spilling to its temporary files if it
+  /// has to, and each column is written out as the sorted rows arrive, so
+  /// only the facility list is held in memory.
+  /// @param simid the simulation, as hex(SimId)
+  static void Build(const std::string& db, const std::string& path,
+                    const struct stat& st, const std::string& simid) {
+    if (simid.size() >= sizeof(Header().simid)) {
+      throw std::runtime_error("bad simulation id " + simid);
+    }
+    sqlite3* conn = Connect_(db);
+
+    std::vector<Agent> agents;
+    std::map<int32_t, int> index;
+    Statement q(conn,
+                "SELECT AgentId, EnterTime, Prototype FROM AgentEntry "
+                "WHERE Spec LIKE '%:cyder:%' AND hex(SimId) = ?1 "
+                "ORDER BY AgentId");
+    q.Bind(1, simid);
+    while (q.Step()) {
+      Agent a;
+      std::memset(&a, 0, sizeof(a));
+      a.id = q.Int(0);
+      a.enter_time = q.Int(1);
+      std::strncpy(a.prototype, q.Text(2), sizeof(a.prototype) - 1);
+      index[a.id] = agents.size();
+      agents.push_back(a);
+    }
+    q.Finalize();
+
+    Header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, kMagic, sizeof(h.magic));
+    h.db_size = st.st_size;
+    h.db_mtime = st.st_mtime;
+    h.n_agents = agents.size();
+    std::strncpy(h.simid, simid.c_str(), sizeof(h.simid) - 1);
+    std::vector<int64_t> begins(agents.size() + 1, 0);
+
+    // the header and row counts are filled in once every row is written;
+    // time and dir are written to their own files and appended after qty
+    std::string tmp = path + ".tmp";
+    File out(tmp);
+    File time_out(tmp + ".time");
+    File dir_out(tmp + ".dir");
+    Write_(out.f, &h, 1);
+    Write_(out.f, agents.empty() ? NULL : &agents[0], agents.size());
+    Write_(out.f, &begins[0], begins.size());
+
+    if (HasTable_(conn, "ConditioningFlows")) {
+      Statement f(conn,
+                  "SELECT AgentId, EndTime, InventoryHeld, ProcessingHeld, "
+                  "PackagedHeld, ReadyHeld, StocksHeld FROM ConditioningFlows "
+                  "WHERE hex(SimId) = ?1 ORDER BY AgentId, EndTime");
+      f.Bind(1, simid);
+      while (f.Step()) {
+        Stages s = {f.Int(0), f.Int(1), {0, 0, 0, 0, 0}};
+        for (int i = 0; i < 5; ++i) {
+          s.held[i] = f.Double(2 + i);
+        }
+        Write_(out.f, &s, 1);
+        ++h.n_stages;
+      }
+    }
+
+    // each transaction touching a cyder facility, once for the sender and
+    // once for the receiver, in the order they were recorded within a
+    // timestep
+    Statement t(conn,
+                "WITH cyder AS (SELECT AgentId FROM AgentEntry "
+                "               WHERE Spec LIKE '%:cyder:%' "
+                "               AND hex(SimId) = ?1), "
+                "tx AS (SELECT * FROM Transactions WHERE hex(SimId) = ?1), "
+                "rows AS (SELECT SenderId AS Agent, Time, -1 AS Dir, "
+                "                TransactionId, ResourceId FROM tx "
+                "         WHERE SenderId IN (SELECT AgentId FROM cyder) "
+                "         UNION ALL "
+                "         SELECT ReceiverId, Time, 1, TransactionId, "
+                "                ResourceId FROM tx "
+                "         WHERE ReceiverId IN (SELECT AgentId FROM cyder)) "
+                "SELECT rows.Agent, rows.Time, rows.Dir, r.Quantity FROM rows "
+                "LEFT JOIN Resources r ON r.ResourceId = rows.ResourceId "
+                "                      AND hex(r.SimId) = ?1 "
+                "ORDER BY rows.Agent, rows.Time, rows.TransactionId, rows.Dir");
+    t.Bind(1, simid);
+    while (t.Step()) {
+      int32_t time = t.Int(1);
+      int8_t dir = t.Int(2);
+      double qty = t.Double(3);
+      Write_(out.f, &qty, 1);
+      Write_(time_out.f, &time, 1);
+      Write_(dir_out.f, &dir, 1);
+      begins[index[t.Int(0)] + 1] = ++h.n_rows;
+    }
+    t.Finalize();
+    sqlite3_close(conn);
+    for (size_t i = 1; i < begins.size(); ++i) {
+      begins[i] = std::max(begins[i], begins[i - 1]);
+    }
+
+    Append_(out.f, &time_out);
+    Append_(out.f, &dir_out);
+    if (std::fseek(out.f, 0, SEEK_SET) != 0) {
+      throw std::runtime_error("cannot write cache " + tmp);
+    }
+    Write_(out.f, &h, 1);
+    Write_(out.f, agents.empty() ? NULL : &agents[0], agents.size());
+    Write_(out.f, &begins[0], begins.size());
+    if (!out.Close() || std::rename(tmp.c_str(), path.c_str())) {
+      throw std::runtime_error("cannot write cache " + path);
+    }
+  }
+
+ private:
+  static constexpr const char* kMagic = "CYDPOST2";
+
+  struct Header {
+    char magic[8];
+    int64_t db_size;
+    int64_t db_mtime;
+    int64_t n_agents;
+    int64_t n_rows;
+    int64_t n_stages;
+    char simid[40];
+  };
+
+  /// A prepared statement that is stepped through row by row.
+  class Statement {
+   public:
+    Statement(sqlite3* conn, const char* sql) : stmt_(NULL) {
+      if (sqlite3_prepare_v2(conn, sql, -1, &stmt_, NULL) != SQLITE_OK) {
+        throw std::runtime_error(std::string("query failed: ") +
+                                 sqlite3_errmsg(conn));
+      }
+    }
+    ~Statement() { Finalize(); }
+
+    /// binds text to a parameter, numbered from 1
+    void Bind(int i, const std::string& text) {
+      sqlite3_bind_text(stmt_, i, text.c_str(), -1, SQLITE_TRANSIENT);
+    }
+
+    bool Step() { return sqlite3_step(stmt_) == SQLITE_ROW; }
+    void Finalize() {
+      sqlite3_finalize(stmt_);
+      stmt_ = NULL;
+    }
+
+    int32_t Int(int col) { return sqlite3_column_int(stmt_, col); }
+    int64_t Int64(int col) { return sqlite3_column_int64(stmt_, col); }
+    double Double(int col) { return sqlite3_column_double(stmt_, col); }
+    const char* Text(int col) {
+      const unsigned char* s = sqlite3_column_text(stmt_, col);
+      return s == NULL ? "" : reinterpret_cast<const char*>(s);
+    }
+
+   private:
+    sqlite3_stmt* stmt_;
+  };
+
+  /// A file written while the cache is built, removed unless it is kept by
+  /// renaming it once closed.
+  struct File {
+    explicit File(const std::string& path)
+        : path(path), f(std::fopen(path.c_str(), "w+b")) {
+      if (f == NULL) {
+        throw std::runtime_error("cannot write cache " + path);
+      }
+    }
+    ~File() {
+      if (f != NULL) {
+        std::fclose(f);
+        std::remove(path.c_str());
+      }
+    }
+
+    bool Close() {
+      bool ok = std::fclose(f) == 0;
+      f = NULL;
+      return ok;
+    }
+
+    std::string path;
+    FILE* f;
+  };
+
+  /// copies all of a file to the end of another
+  static void Append_(FILE* out, File* part) {
+    std::rewind(part->f);
+    char buf[1 << 16];
+    size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), part->f)) > 0) {
+      Write_(out, buf, n);
+    }
+    if (std::ferror(part->f)) {
+      throw std::runtime_error("cannot read " + part->path);
+    }
+  }
+
+  static sqlite3* Connect_(const std::string& db) {
+    sqlite3* conn;
+    if (sqlite3_open_v2(db.c_str(), &conn, SQLITE_OPEN_READONLY, NULL) !=
+        SQLITE_OK) {
+      sqlite3_close(conn);
+      throw std::runtime_error("cannot open " + db);
+    }
+    return conn;
+  }
+
+  static bool HasTable_(sqlite3* conn, const char* name) {
+    Statement q(conn,
+                "SELECT name FROM sqlite_master WHERE type = 'table'");
+    while (q.Step()) {
+      if (std::strcmp(q.Text(0), name) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  template <class T>
+  static void Write_(FILE* out, const T* data, size_t n) {
+    if (n > 0 && std::fwrite(data, sizeof(T), n, out) != n) {
+      throw std::runtime_error("cannot write cache");
+    }
+  }
+
+  /// maps the cache file, returning false if it is missing, stale or for
+  /// another simulation
+  bool Map_(const std::string& path, const struct stat& db,
+            const std::string& simid) {
+    Unmap_();
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        st.st_size < static_cast<off_t>(sizeof(Header))) {
+      close(fd);
+      return false;
+    }
+    void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+      return false;
+    }
+    data_ = static_cast<const char*>(p);
+    size_ = st.st_size;
+
+    header_ = reinterpret_cast<const Header*>(data_);
+    if (std::memcmp(header_->magic, kMagic, sizeof(header_->magic)) != 0 ||
+        header_->db_size != db.st_size || header_->db_mtime != db.st_mtime ||
+        simid != header_->simid) {
+      Unmap_();
+      return false;
+    }
+
+    // columns are laid out widest first so each stays aligned
+    const char* p2 = data_ + sizeof(Header);
+    agents_ = reinterpret_cast<const Agent*>(p2);
+    p2 += header_->n_agents * sizeof(Agent);
+    begins_ = reinterpret_cast<const int64_t*>(p2);
+    p2 += (header_->n_agents + 1) * sizeof(int64_t);
+    stages_ = reinterpret_cast<const Stages*>(p2);
+    p2 += header_->n_stages * sizeof(Stages);
+    qty_ = reinterpret_cast<const double*>(p2);
+    p2 += header_->n_rows * sizeof(double);
+    time_ = reinterpret_cast<const int32_t*>(p2);
+    p2 += header_->n_rows * sizeof(int32_t);
+    dir_ = reinterpret_cast<const int8_t*>(p2);
+    p2 += header_->n_rows * sizeof(int8_t);
+    if (static_cast<size_t>(p2 - data_) != size_) {
+      Unmap_();
+      return false;
+    }
+    return true;
+  }
+
+  void Unmap_() {
+    if (data_ != NULL) {
+      munmap(const_cast<char*>(data_), size_);
+      data_ = NULL;
+    }
+  }
+
+  const char* data_;
+  size_t size_;
+  const Header* header_;
+  const Agent* agents_;
+  const int64_t* begins_;
+  const Stages* stages_;
+  const int32_t* time_;
+  const double* qty_;
+  const int8_t* dir_;
+};
+
+}  // namespace cyder_post
+
+#endif  // CYDER_TOOLS_POST_CACHE_H_